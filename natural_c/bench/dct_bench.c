@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "dct.h"
+#include "quantization.h"
+#include "kernels.h"
+
+// Blocks in one 1920x1280 frame, used to report per-frame DCT stage time
+#define FRAME_BLOCKS ((1920 / 8) * (1280 / 8))
+
+// Number of distinct random blocks and how many times each set is transformed
+#define NUM_BLOCKS 1024
+#define ITERATIONS 200
+
+static double nowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Returns the average time per block in nanoseconds
+static double timeDCT(DCTBlockFn fn, int8_t (*blocks)[8][8], float (*out)[8][8])
+{
+    double start = nowSeconds();
+
+    for (int it = 0; it < ITERATIONS; it++)
+    {
+        for (int b = 0; b < NUM_BLOCKS; b++)
+        {
+            fn(blocks[b], out[b]);
+        }
+    }
+
+    double elapsed = nowSeconds() - start;
+    return elapsed * 1e9 / ((double)ITERATIONS * NUM_BLOCKS);
+}
+
+// Same as timeDCT for the fixed-point DCT, which writes int16 coefficients
+static double timeDCTInt(int8_t (*blocks)[8][8], int16_t (*out)[8][8])
+{
+    double start = nowSeconds();
+
+    for (int it = 0; it < ITERATIONS; it++)
+    {
+        for (int b = 0; b < NUM_BLOCKS; b++)
+        {
+            computeDCTBlockInt(blocks[b], out[b]);
+        }
+    }
+
+    double elapsed = nowSeconds() - start;
+    return elapsed * 1e9 / ((double)ITERATIONS * NUM_BLOCKS);
+}
+
+int main(void)
+{
+    int8_t (*blocks)[8][8] = malloc(NUM_BLOCKS * sizeof(*blocks));
+    float (*outDirect)[8][8] = malloc(NUM_BLOCKS * sizeof(*outDirect));
+    float (*outSeparable)[8][8] = malloc(NUM_BLOCKS * sizeof(*outSeparable));
+    float (*outAAN)[8][8] = malloc(NUM_BLOCKS * sizeof(*outAAN));
+    int16_t (*outInt)[8][8] = malloc(NUM_BLOCKS * sizeof(*outInt));
+
+    if (!blocks || !outDirect || !outSeparable || !outAAN || !outInt)
+    {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return 1;
+    }
+
+    srand(1234);
+    for (int b = 0; b < NUM_BLOCKS; b++)
+    {
+        for (int y = 0; y < 8; y++)
+        {
+            for (int x = 0; x < 8; x++)
+            {
+                blocks[b][y][x] = (int8_t)((rand() % 256) - 128);
+            }
+        }
+    }
+
+    double nsDirect = timeDCT(computeDCTBlockDirect, blocks, outDirect);
+    double nsSeparable = timeDCT(computeDCTBlock, blocks, outSeparable);
+    double nsAAN = timeDCT(computeDCTBlockAAN, blocks, outAAN);
+    double nsInt = timeDCTInt(blocks, outInt);
+
+    // Separable implementation selected by the kernel registry
+    DCTBlockFn bestDCT = getJpegKernels()->dctBlock;
+    double nsBest = timeDCT(bestDCT, blocks, outAAN);
+    float maxDiffBest = 0.0f;
+    for (int b = 0; b < NUM_BLOCKS; b++)
+    {
+        for (int u = 0; u < 8; u++)
+        {
+            for (int v = 0; v < 8; v++)
+            {
+                float diff = fabsf(outDirect[b][u][v] - outAAN[b][u][v]);
+                if (diff > maxDiffBest)
+                    maxDiffBest = diff;
+            }
+        }
+    }
+
+    // outAAN is reused below for the AAN output
+    timeDCT(computeDCTBlockAAN, blocks, outAAN);
+
+    // Largest coefficient difference against the direct formula.
+    // AAN output is compared after removing the scaling that quantization normally absorbs.
+    float maxDiff = 0.0f;
+    float maxDiffAAN = 0.0f;
+    float maxDiffInt = 0.0f;
+    for (int b = 0; b < NUM_BLOCKS; b++)
+    {
+        for (int u = 0; u < 8; u++)
+        {
+            for (int v = 0; v < 8; v++)
+            {
+                float diff = fabsf(outDirect[b][u][v] - outSeparable[b][u][v]);
+                if (diff > maxDiff)
+                    maxDiff = diff;
+
+                float aanScale = 8.0f * AAN_SCALE_FACTOR[u] * AAN_SCALE_FACTOR[v];
+                float diffAAN = fabsf(outDirect[b][u][v] - outAAN[b][u][v] / aanScale);
+                if (diffAAN > maxDiffAAN)
+                    maxDiffAAN = diffAAN;
+
+                // The integer DCT output is scaled by 8
+                float diffInt = fabsf(outDirect[b][u][v] - outInt[b][u][v] / 8.0f);
+                if (diffInt > maxDiffInt)
+                    maxDiffInt = diffInt;
+            }
+        }
+    }
+
+    printf("DCT benchmark (%d blocks x %d iterations)\n", NUM_BLOCKS, ITERATIONS);
+    printf("Direct (4096 MAC)   : %8.1f ns/block\n", nsDirect);
+    printf("Separable (1024 MAC): %8.1f ns/block\n", nsSeparable);
+    printf("AAN (5 mul per 1-D) : %8.1f ns/block\n", nsAAN);
+    printf("Integer (LLM)       : %8.1f ns/block\n", nsInt);
+    printf("Best for this CPU   : %8.1f ns/block (%s)\n", nsBest,
+           getJpegKernels()->dctName);
+    printf("Speedup separable   : %8.2fx\n", nsDirect / nsSeparable);
+    printf("Speedup AAN         : %8.2fx\n", nsDirect / nsAAN);
+    printf("Speedup integer     : %8.2fx\n", nsDirect / nsInt);
+    printf("Speedup best        : %8.2fx\n", nsDirect / nsBest);
+    printf("1920x1280 DCT stage : %8.2f ms direct, %8.2f ms best\n",
+           nsDirect * FRAME_BLOCKS * 1e-6, nsBest * FRAME_BLOCKS * 1e-6);
+    printf("Max abs difference  : %8.5f (separable), %8.5f (AAN), %8.5f (integer), %8.5f (best)\n",
+           maxDiff, maxDiffAAN, maxDiffInt, maxDiffBest);
+
+    free(blocks);
+    free(outDirect);
+    free(outSeparable);
+    free(outAAN);
+    free(outInt);
+
+    // The integer DCT rounds to 1/8 of a coefficient, so it gets a looser bound
+    return (maxDiff < 0.01f && maxDiffAAN < 0.01f && maxDiffInt < 0.25f && maxDiffBest < 0.01f) ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "jpeg_handler.h"
+
+// One 1920x1280 frame, encoded ITERATIONS times per output path
+#define WIDTH 1920
+#define HEIGHT 1280
+#define ITERATIONS 20
+
+#define TEMP_PATH "/tmp/encode_bench.jpeg"
+
+static double nowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Gradients plus some noise, so the scan has a realistic mix of symbols
+static void fillImage(BMPImage *img, int noise)
+{
+    for (int y = 0; y < img->height; y++)
+    {
+        for (int x = 0; x < img->width; x++)
+        {
+            uint8_t *p = &img->data[((size_t)y * img->width + x) * 3];
+            p[0] = (uint8_t)((x + (noise ? rand() % noise : 0)) & 0xFF);
+            p[1] = (uint8_t)((y + (noise ? rand() % noise : 0)) & 0xFF);
+            p[2] = (uint8_t)(((x ^ y) + (noise ? rand() % noise : 0)) & 0xFF);
+        }
+    }
+}
+
+// The file round trip the in-memory API replaces: encode to a file, read it back
+static bool encodeThroughFile(JpegEncoder *encoder, const BMPImage *img, uint8_t *out, size_t capacity, size_t *size)
+{
+    if (!saveJPEGGrayscaleWithEncoder(encoder, TEMP_PATH, img))
+        return false;
+
+    FILE *file = fopen(TEMP_PATH, "rb");
+    if (!file)
+        return false;
+
+    *size = fread(out, 1, capacity, file);
+    fclose(file);
+    return *size > 0;
+}
+
+int main(void)
+{
+    BMPImage img;
+    memset(&img, 0, sizeof(img));
+    img.width = WIDTH;
+    img.height = HEIGHT;
+    img.data = (uint8_t *)malloc((size_t)WIDTH * HEIGHT * 3);
+
+    size_t capacity = jpegMaxEncodedSize(WIDTH, HEIGHT);
+    uint8_t *fileBytes = (uint8_t *)malloc(capacity);
+    uint8_t *memoryBytes = (uint8_t *)malloc(capacity);
+
+    JpegEncoderConfig config;
+    initJpegEncoderConfig(&config);
+    config.verbose = false;
+    JpegEncoder *encoder = createJpegEncoder(&config, WIDTH, HEIGHT);
+
+    if (!img.data || !fileBytes || !memoryBytes || !encoder)
+    {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return 1;
+    }
+
+    srand(1234);
+    fillImage(&img, 16);
+
+    size_t fileSize = 0, memorySize = 0;
+    bool ok = true;
+
+    double start = nowSeconds();
+    for (int it = 0; it < ITERATIONS && ok; it++)
+        ok &= encodeThroughFile(encoder, &img, fileBytes, capacity, &fileSize);
+    double msFile = (nowSeconds() - start) * 1e3 / ITERATIONS;
+
+    start = nowSeconds();
+    for (int it = 0; it < ITERATIONS && ok; it++)
+        ok &= encodeJPEGGrayscaleToMemory(encoder, &img, memoryBytes, capacity, &memorySize);
+    double msMemory = (nowSeconds() - start) * 1e3 / ITERATIONS;
+
+    bool same = ok && fileSize == memorySize && memcmp(fileBytes, memoryBytes, fileSize) == 0;
+    remove(TEMP_PATH);
+
+    // Pure noise at quality 100 with optimized tables is about as large as a JPEG gets
+    JpegEncoderConfig worstConfig = config;
+    worstConfig.quality = 100;
+    worstConfig.optimizeHuffman = true;
+    worstConfig.restartRows = 1;
+    JpegEncoder *worstEncoder = createJpegEncoder(&worstConfig, WIDTH, HEIGHT);
+
+    fillImage(&img, 256);
+    size_t worstSize = 0;
+    bool fits = worstEncoder && encodeJPEGGrayscaleToMemory(worstEncoder, &img, memoryBytes, capacity, &worstSize);
+
+    printf("Encode output benchmark (%dx%d, %d iterations)\n", WIDTH, HEIGHT, ITERATIONS);
+    printf("File + read back    : %8.2f ms/image\n", msFile);
+    printf("In memory           : %8.2f ms/image\n", msMemory);
+    printf("Same bytes          : %s (%zu bytes)\n", same ? "yes" : "NO", memorySize);
+    printf("Worst case          : %zu of %zu bound bytes (%s)\n", worstSize, capacity, fits ? "fits" : "DOES NOT FIT");
+
+    freeJpegEncoder(encoder);
+    freeJpegEncoder(worstEncoder);
+    free(img.data);
+    free(fileBytes);
+    free(memoryBytes);
+
+    return same && fits ? 0 : 1;
+}
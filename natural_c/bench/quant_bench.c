@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "quantization.h"
+#include "kernels.h"
+
+// Blocks in one 1920x1280 frame, used to report per-frame quantization stage time
+#define FRAME_BLOCKS ((1920 / 8) * (1280 / 8))
+
+// Number of distinct random blocks and how many times each set is quantized
+#define NUM_BLOCKS 1024
+#define ITERATIONS 200
+
+static double nowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// The old per-coefficient divide, kept as the baseline
+static void quantizeZigZagBlockDivide(const float coeffs[64], const float reciprocals[64], int16_t out[64])
+{
+    (void)reciprocals;
+    for (int i = 0; i < 64; i++)
+    {
+        int pos = ZIGZAG_ORDER[i];
+        out[i] = (int16_t)roundf(coeffs[pos] / (float)std_luminance_quant_tbl[pos]);
+    }
+}
+
+// Returns the average time per block in nanoseconds
+static double timeQuant(QuantizeZigZagFn fn, const QuantTables* tables, float (*blocks)[64], int16_t (*out)[64])
+{
+    double start = nowSeconds();
+
+    for (int it = 0; it < ITERATIONS; it++)
+    {
+        for (int b = 0; b < NUM_BLOCKS; b++)
+        {
+            fn(blocks[b], tables->reciprocals, out[b]);
+        }
+    }
+
+    double elapsed = nowSeconds() - start;
+    return elapsed * 1e9 / ((double)ITERATIONS * NUM_BLOCKS);
+}
+
+static double timeQuantInt(QuantizeZigZagIntFn fn, const QuantTables* tables, int16_t (*blocks)[64], int16_t (*out)[64])
+{
+    double start = nowSeconds();
+
+    for (int it = 0; it < ITERATIONS; it++)
+    {
+        for (int b = 0; b < NUM_BLOCKS; b++)
+        {
+            fn(blocks[b], tables, out[b]);
+        }
+    }
+
+    double elapsed = nowSeconds() - start;
+    return elapsed * 1e9 / ((double)ITERATIONS * NUM_BLOCKS);
+}
+
+int main(void)
+{
+    float (*blocks)[64] = malloc(NUM_BLOCKS * sizeof(*blocks));
+    int16_t (*intBlocks)[64] = malloc(NUM_BLOCKS * sizeof(*intBlocks));
+    int16_t (*outScalar)[64] = malloc(NUM_BLOCKS * sizeof(*outScalar));
+    int16_t (*outBest)[64] = malloc(NUM_BLOCKS * sizeof(*outBest));
+
+    if (!blocks || !intBlocks || !outScalar || !outBest)
+    {
+        fprintf(stderr, "Error: Memory allocation failed.\n");
+        return 1;
+    }
+
+    srand(1234);
+    for (int b = 0; b < NUM_BLOCKS; b++)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            blocks[b][i] = ((float)rand() / RAND_MAX - 0.5f) * 2048.0f;
+            intBlocks[b][i] = (int16_t)((rand() % 16384) - 8192);
+        }
+    }
+
+    QuantTables tables;
+    initQuantTables(&tables, std_luminance_quant_tbl);
+    const JpegKernels* kernels = getJpegKernels();
+
+    double nsDivide = timeQuant(quantizeZigZagBlockDivide, &tables, blocks, outScalar);
+    double nsScalar = timeQuant(quantizeZigZagBlock, &tables, blocks, outScalar);
+    double nsBest = timeQuant(kernels->quantizeZigZag, &tables, blocks, outBest);
+    int mismatches = memcmp(outScalar, outBest, NUM_BLOCKS * sizeof(*outScalar)) != 0;
+
+    double nsIntScalar = timeQuantInt(quantizeZigZagBlockInt, &tables, intBlocks, outScalar);
+    double nsIntBest = timeQuantInt(kernels->quantizeZigZagInt, &tables, intBlocks, outBest);
+    mismatches += memcmp(outScalar, outBest, NUM_BLOCKS * sizeof(*outScalar)) != 0;
+
+    printf("Quantization benchmark (%d blocks x %d iterations)\n", NUM_BLOCKS, ITERATIONS);
+    printf("Divide + roundf     : %8.1f ns/block\n", nsDivide);
+    printf("Reciprocal scalar   : %8.1f ns/block\n", nsScalar);
+    printf("Reciprocal best     : %8.1f ns/block (%s)\n", nsBest, kernels->quantizeName);
+    printf("Integer scalar      : %8.1f ns/block\n", nsIntScalar);
+    printf("Integer best        : %8.1f ns/block (%s)\n", nsIntBest, kernels->quantizeIntName);
+    printf("1920x1280 quant     : %8.2f ms divide, %8.2f ms best\n",
+           nsDivide * FRAME_BLOCKS * 1e-6, nsBest * FRAME_BLOCKS * 1e-6);
+    printf("SIMD matches scalar : %s\n", mismatches == 0 ? "yes" : "NO");
+
+    free(blocks);
+    free(intBlocks);
+    free(outScalar);
+    free(outBest);
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#ifndef JPEG_ARENA_H
+#define JPEG_ARENA_H
+
+#include <stddef.h>
+
+// Every allocation starts on a cache line, so per-thread scratch never shares one
+#define ARENA_ALIGNMENT 64
+
+/**
+ * Bump allocator over one block of memory. Allocations are never freed one
+ * by one; resetArena releases all of them at once in O(1), so a loop that
+ * allocates the same scratch for every item only touches the heap once.
+ */
+typedef struct {
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+} Arena;
+
+// Bytes an allocation of size takes in the arena, for sizing one up front
+size_t arenaAllocationSize(size_t size);
+
+Arena* createArena(size_t capacity);
+
+// Returns NULL when the arena is full
+void* arenaAlloc(Arena* arena, size_t size);
+
+void resetArena(Arena* arena);
+
+void freeArena(Arena* arena);
+
+#endif
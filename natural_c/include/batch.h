@@ -0,0 +1,50 @@
+#ifndef JPEG_BATCH_H
+#define JPEG_BATCH_H
+
+#include <stdbool.h>
+#include "jpeg_handler.h"
+
+// Input and output paths of every image in a batch
+typedef struct {
+    char** inputPaths;
+    char** outputPaths;
+    int count;
+    int capacity;
+} BatchJobList;
+
+typedef struct {
+    int numImages;
+    int numFailed;
+    double megapixels; // Pixels of the images that loaded, in millions
+    double seconds;    // Wall time of the whole batch
+} BatchResult;
+
+/**
+ * Collects the jobs of a batch from source, which is either
+ *  - a directory: every .bmp file in it, in name order, or
+ *  - a text file with one job per line: "input" (file list) or
+ *    "input output" (manifest). Blank lines and '#' comments are skipped.
+ * Images without an output path are written to outputDir/<name>.jpeg.
+ */
+bool loadBatchJobs(const char* source, const char* outputDir, BatchJobList* jobs);
+
+void freeBatchJobs(BatchJobList* jobs);
+
+/**
+ * Encodes every job with config on config->threadPool (or a pool of
+ * config->numThreads threads). Images are one task group; each image splits
+ * into band tasks that idle workers steal, so a large image at the end of the
+ * batch still keeps every thread busy. Returns false if any image failed.
+ */
+bool runBatch(const BatchJobList* jobs, const JpegEncoderConfig* config, BatchResult* result);
+
+/**
+ * Same result as runBatch, but as a pipeline: a reader thread loads the next
+ * images while the calling thread encodes one on config->threadPool and a
+ * writer thread stores the previous ones, so disk I/O overlaps compute.
+ * The stages hand pre-allocated image/bitstream slots to each other through
+ * bounded lock-free rings; the slots are recycled, not reallocated.
+ */
+bool runBatchPipeline(const BatchJobList* jobs, const JpegEncoderConfig* config, BatchResult* result);
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -34,15 +35,68 @@ typedef struct BMPInfoHeader{
 } BMPInfoHeader;
 #pragma pack(pop)
 
+// Byte order of the pixels the converter reads
+typedef enum {
+    BMP_CHANNELS_RGB = 0, // Packed RGB, as in data
+    BMP_CHANNELS_BGR      // As stored in BMP files
+} BMPChannelOrder;
+
+/**
+ * Pixels are read through a view: row y (0 = top) starts at
+ * pixels + y * stride. Loaded images point the view at data (packed RGB);
+ * mapped images point it into the file mapping, where rows are BGR, padded
+ * to 4 bytes and stored bottom-up unless biHeight is negative (then the
+ * stride is negative). Images filled in by hand may leave pixels NULL; the
+ * view then defaults to packed RGB rows in data.
+ */
 typedef struct BMPImage{
     int32_t width;
     int32_t height;
     uint8_t* data;  // Pixel data (RGB format). Must be freed manually.
+    size_t capacity; // Bytes allocated at data, reused by loadBMPImageInto
+
+    const uint8_t* pixels;        // Top row of the view
+    ptrdiff_t stride;             // Bytes from one row to the next (may be negative)
+    BMPChannelOrder channelOrder;
+    int rowPadding;               // Bytes after the last pixel of each row
+
+    void* mapping;                // Whole-file mapping behind a mapped view
+    size_t mappingSize;
 } BMPImage;
 
+static inline bool hasBMPImagePixels(const BMPImage* image) {
+    return image->pixels != NULL || image->data != NULL;
+}
+
+static inline const uint8_t* getBMPImageRow(const BMPImage* image, int y) {
+    if (image->pixels == NULL) {
+        return image->data + (size_t)y * image->width * 3;
+    }
+    return image->pixels + (ptrdiff_t)y * image->stride;
+}
+
 void freeBMPImage(BMPImage* image);
 
 BMPImage* loadBMPImage(const char* filename);
 
+/**
+ * Loads filename into an existing image, keeping its pixel buffer when it
+ * is large enough, so a loop over many files stops allocating once it has
+ * seen the largest one. Start from a zeroed BMPImage.
+ */
+bool loadBMPImageInto(const char* filename, BMPImage* image);
+
+/**
+ * Maps filename read-only and points the image's view straight at its
+ * pixel rows, BGR and in file order, without copying or converting them.
+ * The view stays valid until unmapBMPImage, freeBMPImage or the next load
+ * or map into the same image. data is left untouched (saveBMPImage still
+ * needs a loaded image). Start from a zeroed BMPImage.
+ */
+bool mapBMPImage(const char* filename, BMPImage* image);
+
+// Drops a mapping made by mapBMPImage, if any
+void unmapBMPImage(BMPImage* image);
+
 bool saveBMPImage(const char* filename, const BMPImage* image);
 #endif
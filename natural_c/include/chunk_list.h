@@ -0,0 +1,59 @@
+#ifndef JPEG_CHUNK_LIST_H
+#define JPEG_CHUNK_LIST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Bytes per page; a multiple of 8, so raw 64-bit words never straddle pages
+#define JPEG_PAGE_SIZE (64 * 1024)
+
+typedef struct JpegPage {
+    struct JpegPage* next;
+    size_t size; // Bytes used in data
+    uint8_t data[JPEG_PAGE_SIZE];
+} JpegPage;
+
+/**
+ * Free list of pages shared by the chunk lists of one encoder. Any thread
+ * may take and return pages (it sits on a lock-free ring); up to
+ * maxCachedPages returned pages are kept for reuse, the rest are freed.
+ */
+typedef struct JpegPagePool JpegPagePool;
+
+JpegPagePool* createJpegPagePool(int maxCachedPages);
+void freeJpegPagePool(JpegPagePool* pool);
+
+/**
+ * Output as a list of fixed-size pages instead of one growing array: it
+ * grows one page at a time without ever copying what is already written,
+ * pages can be moved between lists, and the pages map directly onto the
+ * iovecs of a writev.
+ */
+typedef struct {
+    JpegPagePool* pool;
+    JpegPage* head;
+    JpegPage* tail;
+    size_t size;  // Bytes in all pages
+    int numPages;
+} JpegChunkList;
+
+void initJpegChunkList(JpegChunkList* list, JpegPagePool* pool);
+
+// Copies size bytes to the end of list, taking pages from its pool as needed
+bool appendJpegChunkList(JpegChunkList* list, const void* data, size_t size);
+
+// Moves every page of src to the end of dst; src is left empty
+void spliceJpegChunkList(JpegChunkList* dst, JpegChunkList* src);
+
+// Returns every page to the pool; the list is left empty
+void clearJpegChunkList(JpegChunkList* list);
+
+/**
+ * Writes prefix (may be NULL) and then every page of list to the file
+ * descriptor fd with writev, straight from the pages. Up to IOV_MAX pages
+ * go out in one call; short writes are continued.
+ */
+bool writeJpegChunkList(int fd, const void* prefix, size_t prefixSize, const JpegChunkList* list);
+
+#endif
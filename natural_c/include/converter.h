@@ -25,9 +25,35 @@ typedef struct {
                          // Values 0-255 (where 0=black, 255=white)
 } YImage;
 
+YImage* createYImage(int width, int height);
 YImage* convertBMPToJPEGGrayscale(const BMPImage* image);
 
+/**
+ * Converts rows [startRow, startRow + band->height) of the RGB image into
+ * the preallocated band. Rows and columns outside the image are filled by
+ * repeating the last row/column, exactly like convertBMPToJPEGGrayscale.
+ */
+void convertBMPRowsToY(const BMPImage* image, int startRow, YImage* band);
+
+// Converts count packed RGB pixels to Y with the integer BT.601 weights
+typedef void (*ColorConvertRowFn)(const uint8_t* rgb, int count, uint8_t* yRow);
+
+void convertRGBRowToY(const uint8_t* rgb, int count, uint8_t* yRow);
+
+// Same for BGR pixels as stored in BMP files (mapped images)
+void convertBGRRowToY(const uint8_t* bgr, int count, uint8_t* yRow);
+
+#if defined(__x86_64__) || defined(__i386__)
+// SIMD variants of the above, bit-exact with them. Selected through kernels.h.
+void convertRGBRowToYSSSE3(const uint8_t* rgb, int count, uint8_t* yRow);
+void convertRGBRowToYAVX2(const uint8_t* rgb, int count, uint8_t* yRow);
+void convertBGRRowToYSSSE3(const uint8_t* bgr, int count, uint8_t* yRow);
+void convertBGRRowToYAVX2(const uint8_t* bgr, int count, uint8_t* yRow);
+#endif
+
+CenteredYImage* createCenteredYImage(int width, int height);
 CenteredYImage *centerYImage(const YImage *source);
+void centerYImageInto(const YImage* source, CenteredYImage* dest);
 void freeCenteredYImage(CenteredYImage* img);
 
 #endif
\ No newline at end of file
@@ -18,9 +18,39 @@ typedef struct {
                          // Size = width * height.
 } DCTImage;
 
+// Selectable DCT implementation used by the block transform
+typedef enum {
+    DCT_ENGINE_SEPARABLE = 0, // Row-column matrix DCT, outputs true coefficients
+    DCT_ENGINE_AAN,           // AAN fast DCT, output scaling folded into quantization
+    DCT_ENGINE_INTEGER        // Fixed-point DCT and reciprocal-multiply quantization, bit-exact everywhere
+} DCTEngine;
+
 //void initDCTTables();
+
+// Separable row-column DCT (T * X * T'), used by the encoder
 void computeDCTBlock(const int8_t inputBlock[8][8], float outputBlock[8][8]);
+
+typedef void (*DCTBlockFn)(const int8_t inputBlock[8][8], float outputBlock[8][8]);
+
+#if defined(__x86_64__) || defined(__i386__)
+// AVX2 + FMA separable DCT; matches computeDCTBlock within float rounding.
+// Only call it on CPUs with AVX2 and FMA (see getJpegKernels).
+void computeDCTBlockAVX2(const int8_t inputBlock[8][8], float outputBlock[8][8]);
+#endif
+
+// AAN fast DCT (5 multiplies per 1-D pass). Coefficient (u, v) is scaled by
+// 8 * AAN_SCALE_FACTOR[u] * AAN_SCALE_FACTOR[v]; quantize with QuantTables.aanReciprocals.
+void computeDCTBlockAAN(const int8_t inputBlock[8][8], float outputBlock[8][8]);
+
+// Fixed-point (LLM) DCT with 32-bit intermediates. Output is 8 * F(u, v), rounded to int16;
+// quantize with quantizeZigZagBlockInt.
+void computeDCTBlockInt(const int8_t inputBlock[8][8], int16_t outputBlock[8][8]);
+
+// Direct evaluation of the 2-D DCT formula, kept as a reference for benchmarks
+void computeDCTBlockDirect(const int8_t inputBlock[8][8], float outputBlock[8][8]);
+DCTImage *createDCTImage(int width, int height);
 DCTImage *performDCT(const CenteredYImage *image);
+void performDCTInto(const CenteredYImage *image, DCTImage *dctImg);
 void freeDCTImage(DCTImage* img);
 
 
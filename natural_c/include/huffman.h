@@ -3,7 +3,8 @@
 
 #include <stdint.h>
 #include <stdlib.h>
-#include "rle.h"
+#include <stdbool.h>
+#include "zigzag.h"
 
 // Output structure containing the final compressed bytes
 typedef struct {
@@ -14,26 +15,131 @@ typedef struct {
 
 // --- internal structures ---
 
+// Huffman code of one symbol, already shifted left by the symbol's amplitude
+// size (the low nibble of the symbol), so the amplitude bits can be OR-ed in.
 typedef struct {
-    uint16_t code; // The bit sequence (e.g., 1010)
-    uint8_t len;   // The length of the sequence (e.g., 4)
+    uint32_t code; // The bit sequence followed by size zero bits
+    uint8_t len;   // Code length plus amplitude size (at most 16 + 11)
 } HuffmanCode;
 
+// Code tables for one scan, indexed by DC category and by AC (Run << 4) | Size
+typedef struct {
+    HuffmanCode dc[16];
+    HuffmanCode ac[256];
+} HuffmanTables;
+
+// The Annex K luminance tables written by write_dht_dc / write_dht_ac (static data, thread-safe)
+extern const HuffmanTables STD_HUFFMAN_TABLES;
+
+// A Huffman table as stored in a DHT segment
+typedef struct {
+    uint8_t bits[16];    // Number of codes of length 1..16
+    uint8_t values[256]; // Symbols in order of increasing code length
+    int numValues;
+} HuffmanSpec;
+
+// Symbol counts of one scan, indexed like HuffmanTables
+typedef struct {
+    uint32_t dc[16];
+    uint32_t ac[256];
+} HuffmanStats;
+
+/**
+ * Builds the optimal table for the symbol counts freq[0..numSymbols) with code
+ * lengths limited to 16 bits (JPEG Annex K.2). Symbols with a zero count get no code.
+ */
+bool buildOptimalHuffmanSpec(const uint32_t* freq, int numSymbols, HuffmanSpec* spec);
+
+// Derives the encoder lookup tables from the DHT form of the DC and AC tables
+void buildHuffmanTables(const HuffmanSpec* dcSpec, const HuffmanSpec* acSpec, HuffmanTables* tables);
+
 // --- BitWriter Helper ---
 
 typedef struct {
     JpegEncoderBuffer* buffer;
-    uint32_t accumulator; // Temp storage for bits
-    int bitCount;         // How many bits are currently in accumulator
+    uint64_t accumulator; // Pending bits, right-aligned
+    int freeBits;         // Room left in accumulator (64 - pending bits)
+    bool stuffBytes;      // Insert 0x00 after every 0xFF (false for raw band streams)
 } BitWriter;
 
+// Upper bound on the stuffed output of one block: 64 codes of at most
+// 16 + 11 bits plus EOB is 218 bytes, doubled for 0xFF stuffing
+#define HUFFMAN_MAX_BLOCK_BYTES 512
+
+JpegEncoderBuffer* createJpegEncoderBuffer(size_t capacity);
+
+// Copies size bytes to the end of buffer, growing it as needed
+bool appendJpegEncoderBuffer(JpegEncoderBuffer* buffer, const void* data, size_t size);
+
+/**
+ * Prepares a BitWriter that appends to buffer. Bits are carried over
+ * between encodeHuffmanBlocks calls, so an image can be encoded band by band.
+ */
+void initBitWriter(BitWriter* bw, JpegEncoderBuffer* buffer);
+
+/**
+ * Like initBitWriter, but without 0xFF stuffing and never flushed: the buffer
+ * gets whole 64-bit words and the tail stays in the accumulator. Bands coded in
+ * parallel this way are joined in order with appendRawBits.
+ */
+void initRawBitWriter(BitWriter* bw, JpegEncoderBuffer* buffer);
+
+/**
+ * Appends every bit written to raw at the current bit position of bw,
+ * realigning the bits and stuffing 0xFF bytes as bw requires.
+ */
+bool appendRawBits(BitWriter* bw, const BitWriter* raw);
+
+/**
+ * Appends size bytes of whole 64-bit words written by a raw writer (size is a
+ * multiple of 8), like appendRawBits without the pending tail. Lets a long raw
+ * stream be drained and joined piece by piece.
+ */
+bool appendRawWords(BitWriter* bw, const uint8_t* data, size_t size);
+
+/**
+ * Entropy codes every zig-zag block of zigZagData with tables: run-length analysis and
+ * Huffman output happen in one pass, without an intermediate symbol array.
+ * lastDC carries the DC predictor between calls so that consecutive bands
+ * of one image form a single DC chain. Room for the worst case is reserved
+ * once per call; the bits are then written 8 bytes at a time, and up to 63
+ * bits stay in the accumulator. Returns false if the buffer cannot grow.
+ */
+bool encodeHuffmanBlocks(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC);
+
+#if defined(__x86_64__) || defined(__i386__)
+// Same output as encodeHuffmanBlocks; the nonzero mask of each block comes from
+// vector compares + movemask (SSE2/AVX2) or a mask test (AVX-512) instead of a
+// scalar scan, and tzcnt/lzcnt are used when available. Selected through kernels.h.
+bool encodeHuffmanBlocksSSE2(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC);
+bool encodeHuffmanBlocksAVX2(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC);
+bool encodeHuffmanBlocksAVX512(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC);
+#endif
+
+/**
+ * Adds the symbols encodeHuffmanBlocks would emit for zigZagData to stats.
+ * lastDC is carried exactly like in encodeHuffmanBlocks.
+ */
+void gatherHuffmanStats(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC);
+
+#if defined(__x86_64__) || defined(__i386__)
+void gatherHuffmanStatsSSE2(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC);
+void gatherHuffmanStatsAVX2(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC);
+void gatherHuffmanStatsAVX512(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC);
+#endif
+
+/**
+ * Writes out the bits left in the accumulator, padding the final partial byte
+ * with 1-bits. Used at the end of the scan and of every restart interval.
+ */
+bool flushBitWriter(BitWriter* bw);
+
 /**
- * Encodes the RLE data into a JPEG Huffman bitstream.
- * * @param rleData Input RLE symbols.
- * @param totalBlocks Total number of 8x8 blocks (needed for state tracking).
+ * Encodes the zig-zag blocks of a whole image into a JPEG Huffman bitstream.
+ * @param zigZagData Quantized blocks in zig-zag order.
  * @return Pointer to JpegEncoderBuffer containing the bytestream.
  */
-JpegEncoderBuffer* encodeHuffman(const RLEData* rleData, int totalBlocks);
+JpegEncoderBuffer* encodeHuffman(const ZigZagData* zigZagData);
 
 void freeJpegEncoderBuffer(JpegEncoderBuffer* buffer);
 
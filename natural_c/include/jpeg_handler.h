@@ -12,6 +12,10 @@
 #include "bmp_handler.h"
 #include "huffman.h"
 #include "converter.h"
+#include "dct.h"
+#include "quantization.h"
+#include "thread_pool.h"
+#include "chunk_list.h"
 
 // Header indicating this is a standard JFIF JPEG
 #pragma pack(push, 1) // Disable padding bytes
@@ -97,14 +101,95 @@ typedef struct {
 #pragma pack(pop)
 
 
+// Encoder settings. Start from initJpegEncoderConfig() and override fields as needed.
+typedef struct {
+    DCTEngine dctEngine; // DCT implementation used by the block transform
+    int quality;         // IJG quality 1..100 applied to the standard table (default 50)
+
+    // Custom quantization table (see initQuantProfile and loadQuantTableFile).
+    // When set it replaces the standard table and quality is ignored.
+    const QuantProfile* quantProfile;
+
+    // Two passes: count the symbols of the image, then code it with optimal
+    // Huffman tables instead of the Annex K ones (default false)
+    bool optimizeHuffman;
+
+    // MCU rows per restart interval (DRI/RSTn), 0 for none. Each interval resets
+    // the DC predictor and ends with an RSTn marker.
+    int restartRows;
+
+    // Bands are transformed and entropy coded on numThreads threads; only the
+    // joining of their bitstreams is ordered, and the output does not depend on
+    // the thread count. A caller-provided threadPool (see createThreadPool) is
+    // used instead of starting numThreads threads for every image.
+    int numThreads;
+    ThreadPool* threadPool;
+
+    // Progress messages and the first quantized block (default true); errors are always printed
+    bool verbose;
+} JpegEncoderConfig;
+
+void initJpegEncoderConfig(JpegEncoderConfig* config);
+
+// Largest header block (SOI to SOS): APP0, DQT, SOF0, two DHTs of up to 256 symbols, DRI and SOS
+#define JPEG_MAX_HEADER_BYTES (20 + 69 + 13 + 2 * (2 + 2 + 1 + 16 + 256) + 6 + 10)
+
+// Upper bound on the size of the JPEG file of a width x height image, for any settings
+size_t jpegMaxEncodedSize(int width, int height);
+
 bool write_app0(FILE *file);
-bool write_dqt(FILE *file);
+bool write_dqt(FILE *file, const QuantProfile* profile);
 bool write_sof0(FILE *file, int width, int height);
 bool write_dht_dc(FILE *file);
 bool write_dht_ac(FILE *file);
+bool write_dht(FILE *file, uint8_t tableInfo, const HuffmanSpec *spec);
+bool write_dri(FILE *file, uint16_t interval);
 bool write_sos(FILE *file);
 bool write_eoi(FILE *file);
+/**
+ * Reads a 64-entry quantization table in raster order from a text file.
+ * Values (1..255) may be separated by whitespace or commas; '#' starts a comment.
+ */
+bool loadQuantTableFile(const char* path, unsigned char table[64]);
+
 bool saveJPEGGrayscale(const char* filename, const BMPImage* img);
+bool saveJPEGGrayscaleWithConfig(const char* filename, const BMPImage* img, const JpegEncoderConfig* config);
+
+// Writes the whole JPEG stream (SOI to EOI) to an open file or stream
+bool writeJPEGGrayscale(FILE* file, const BMPImage* img, const JpegEncoderConfig* config);
+
+/**
+ * Reusable encoder. It keeps the thread pool, the output buffers and one
+ * arena holding every stage's scratch space between images; the arena is
+ * reset in O(1) per image, so encoding a run of images no larger than the
+ * biggest one seen so far does not touch the heap. A larger image grows the
+ * arena once. An encoder encodes one image at a time.
+ */
+typedef struct JpegEncoder JpegEncoder;
+
+// maxWidth x maxHeight sizes the arena up front; 0 x 0 sizes it on first use
+JpegEncoder* createJpegEncoder(const JpegEncoderConfig* config, int maxWidth, int maxHeight);
+
+bool encodeJPEGGrayscale(JpegEncoder* encoder, FILE* file, const BMPImage* img);
+
+/**
+ * Encodes into the caller's memory instead of a file: headers, scan and EOI
+ * go to output and *encodedSize receives their length. The buffer is never
+ * grown; with capacity >= jpegMaxEncodedSize(img->width, img->height) the
+ * image always fits, otherwise the call fails once output is full.
+ */
+bool encodeJPEGGrayscaleToMemory(JpegEncoder* encoder, const BMPImage* img,
+                                 uint8_t* output, size_t capacity, size_t* encodedSize);
+
+/**
+ * Appends the whole JPEG to output, a chunk list on a page pool of the
+ * caller's. Nothing is ever copied to grow it; write it with
+ * writeJpegChunkList and return the pages with clearJpegChunkList.
+ */
+bool encodeJPEGGrayscaleToChunks(JpegEncoder* encoder, const BMPImage* img, JpegChunkList* output);
+bool saveJPEGGrayscaleWithEncoder(JpegEncoder* encoder, const char* filename, const BMPImage* img);
+
+void freeJpegEncoder(JpegEncoder* encoder);
 
 void freeYImage(YImage* img);
 
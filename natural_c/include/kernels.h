@@ -0,0 +1,64 @@
+#ifndef JPEG_KERNELS_H
+#define JPEG_KERNELS_H
+
+#include <stdio.h>
+#include "converter.h"
+#include "dct.h"
+#include "quantization.h"
+#include "huffman.h"
+
+// Instruction set levels, ordered so a higher level implies the lower ones
+typedef enum {
+    KERNEL_LEVEL_SCALAR = 0,
+    KERNEL_LEVEL_SSE4,      // SSE4.1 + SSSE3
+    KERNEL_LEVEL_AVX2,      // AVX2 + FMA + BMI1 + LZCNT
+    KERNEL_LEVEL_AVX512     // AVX-512 F/BW/VL
+} KernelLevel;
+
+typedef void (*QuantizeZigZagFn)(const float coeffs[64], const float reciprocals[64], int16_t out[64]);
+typedef void (*QuantizeZigZagIntFn)(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]);
+typedef bool (*HuffmanBandFn)(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC);
+typedef void (*HuffmanStatsFn)(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC);
+
+/**
+ * Hot kernels bound once for the running CPU. Every slot also records the
+ * name of the variant it holds so runs can be told apart in logs.
+ */
+typedef struct {
+    KernelLevel cpuLevel;   // Highest level the CPU supports
+    KernelLevel level;      // Level in use (cpuLevel, or lower when capped by JPEG_KERNELS)
+
+    ColorConvertRowFn colorConvertRow;
+    const char* colorConvertName;
+
+    ColorConvertRowFn colorConvertBGRRow; // For images mapped straight from BMP files
+    const char* colorConvertBGRName;
+
+    DCTBlockFn dctBlock;    // Separable engine; AAN and integer engines are scalar by design
+    const char* dctName;
+
+    QuantizeZigZagFn quantizeZigZag;   // Quantization with the zig-zag reorder in its store
+    const char* quantizeName;
+
+    QuantizeZigZagIntFn quantizeZigZagInt;
+    const char* quantizeIntName;
+
+    HuffmanBandFn huffman;  // Run-length analysis, Huffman coding and bit writer in one pass
+    const char* huffmanName;
+
+    HuffmanStatsFn huffmanStats; // Symbol counting for optimized tables
+    const char* huffmanStatsName;
+} JpegKernels;
+
+/**
+ * Returns the kernel table, probing the CPU on the first call (thread-safe).
+ * Setting JPEG_KERNELS=scalar|sse4|avx2|avx512 caps the level, e.g. for A/B runs.
+ */
+const JpegKernels* getJpegKernels(void);
+
+const char* kernelLevelName(KernelLevel level);
+
+// Prints the selected variant of every kernel
+void printJpegKernels(FILE* out);
+
+#endif
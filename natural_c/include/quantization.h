@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "dct.h"
 #include "jpeg_tables.h"
 
@@ -13,7 +14,79 @@ typedef struct {
     int16_t *data; 
 } QuantizedImage;
 
+// Reciprocal quantization tables derived from one 64-entry quantization table (raster order).
+// Rows are 32-byte aligned so the SIMD kernels can load them directly.
+typedef struct {
+    float reciprocals[64] __attribute__((aligned(32)));    // 1 / step, for true DCT coefficients
+    float aanReciprocals[64] __attribute__((aligned(32))); // 1 / step with the AAN output scaling folded in
+
+    // Reciprocal-multiply form of (step * 8) for the integer engine:
+    // q = ((|x| + intCorr) * intRecip) >> intShift, then the sign of x is restored.
+    // intScale = 1 << (32 - intShift) does the same shift as a second 16-bit mulhi.
+    uint16_t intRecip[64] __attribute__((aligned(32)));
+    uint16_t intCorr[64] __attribute__((aligned(32)));
+    uint16_t intScale[64] __attribute__((aligned(32)));
+    uint8_t intShift[64];
+} QuantTables;
+
+// AAN output scale factors: cos(k * PI / 16) * sqrt(2) for k > 0, 1 for k = 0
+extern const float AAN_SCALE_FACTOR[8];
+
+void initQuantTables(QuantTables* tables, const unsigned char quantTbl[64]);
+
+// IJG quality at which a base table is used unscaled
+#define JPEG_DEFAULT_QUALITY 50
+
+// Everything derived from the quantization table of one stream
+typedef struct {
+    int quality;                  // IJG quality the base table was scaled with
+    unsigned char table[64];      // Scaled table, raster order
+    unsigned char dqtPayload[64]; // The same table in zig-zag order, as stored in the DQT segment
+    QuantTables tables;           // Reciprocals used by the quantization kernels
+} QuantProfile;
+
+/**
+ * Scales a base table with the IJG quality formula (1 = smallest file, 100 = best).
+ * Quality is clamped to 1..100 and entries to 1..255 so the table stays baseline.
+ */
+void scaleQuantTable(const unsigned char baseTbl[64], int quality, unsigned char out[64]);
+
+// Fills profile for baseTbl at quality. profile must keep its natural alignment.
+void initQuantProfile(QuantProfile* profile, const unsigned char baseTbl[64], int quality);
+
+/**
+ * Returns the profile of the standard luminance table at quality.
+ * Each quality is built on first use and cached for the life of the process (thread-safe).
+ */
+const QuantProfile* getQuantProfile(int quality);
+
+/**
+ * Quantizes one block of DCT coefficients (raster order) and stores the result
+ * in zig-zag order. reciprocals selects the table matching the DCT engine.
+ * Rounds half away from zero, like roundf.
+ */
+void quantizeZigZagBlock(const float coeffs[64], const float reciprocals[64], int16_t out[64]);
+
+/**
+ * Integer counterpart of quantizeZigZagBlock for the output of computeDCTBlockInt.
+ * Uses only 16/32-bit integer arithmetic and rounds half away from zero.
+ */
+void quantizeZigZagBlockInt(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]);
+
+#if defined(__x86_64__) || defined(__i386__)
+// SIMD variants, bit-exact with the scalar kernels above. Selected through kernels.h.
+// The zig-zag reorder is done in registers (pshufb, or vpermi2w on AVX-512) before the store.
+void quantizeZigZagBlockSSE4(const float coeffs[64], const float reciprocals[64], int16_t out[64]);
+void quantizeZigZagBlockAVX2(const float coeffs[64], const float reciprocals[64], int16_t out[64]);
+void quantizeZigZagBlockAVX512(const float coeffs[64], const float reciprocals[64], int16_t out[64]);
+void quantizeZigZagBlockIntSSE4(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]);
+void quantizeZigZagBlockIntAVX2(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]);
+void quantizeZigZagBlockIntAVX512(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]);
+#endif
+
+QuantizedImage* createQuantizedImage(int width, int height);
 QuantizedImage* quantizeImage(const DCTImage* dctImg);
+void quantizeImageInto(const DCTImage* dctImg, QuantizedImage* qImg);
 void freeQuantizedImage(QuantizedImage* img);
 
 
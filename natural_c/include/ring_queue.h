@@ -0,0 +1,27 @@
+#ifndef JPEG_RING_QUEUE_H
+#define JPEG_RING_QUEUE_H
+
+#include <stdbool.h>
+
+/**
+ * Bounded lock-free queue of pointers (Vyukov's MPMC ring). Any number of
+ * threads may push and pop; with one of each it works as an SPSC ring.
+ * Producers and consumers only meet on the cell they hand over, through
+ * one sequence number per cell, so neither side ever takes a lock.
+ */
+typedef struct RingQueue RingQueue;
+
+// capacity is rounded up to a power of two
+RingQueue* createRingQueue(int capacity);
+
+// Return false instead of waiting when the queue is full / empty
+bool tryPushRingQueue(RingQueue* queue, void* value);
+bool tryPopRingQueue(RingQueue* queue, void** value);
+
+// Wait (spin, then yield, then sleep) until there is room / a value
+void pushRingQueue(RingQueue* queue, void* value);
+void* popRingQueue(RingQueue* queue);
+
+void freeRingQueue(RingQueue* queue);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef JPEG_THREAD_POOL_H
+#define JPEG_THREAD_POOL_H
+
+#include <stdbool.h>
+
+// Called once per task. worker is 0..numThreads-1 and indexes per-thread
+// scratch state; two tasks never run on the same worker at the same time,
+// except that a task waiting in runThreadPoolTasks may run others meanwhile.
+typedef void (*ThreadPoolTaskFn)(void* context, int task, int worker);
+
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * Starts numThreads - 1 helper threads; the calling thread is worker 0.
+ * With numThreads == 1 no threads are created and tasks run inline.
+ * Every worker owns a work-stealing deque: it runs its own tasks newest
+ * first and, when it runs out, steals the oldest tasks of the others.
+ */
+ThreadPool* createThreadPool(int numThreads);
+
+int getThreadPoolSize(const ThreadPool* pool);
+
+/**
+ * Runs tasks 0..numTasks-1 as one task group and returns when all of them
+ * have finished; they may complete in any order. The tasks go on the calling
+ * worker's deque, and the caller keeps running tasks (its own or stolen)
+ * until the group is done, so a task may itself call runThreadPoolTasks,
+ * e.g. an image job splitting into tiles. Threads outside the pool act as
+ * worker 0, so only one of them may use the pool at a time.
+ */
+void runThreadPoolTasks(ThreadPool* pool, int numTasks, ThreadPoolTaskFn fn, void* context);
+
+void freeThreadPool(ThreadPool* pool);
+
+#endif
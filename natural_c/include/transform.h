@@ -0,0 +1,25 @@
+#ifndef JPEG_TRANSFORM_H
+#define JPEG_TRANSFORM_H
+
+#include <stdint.h>
+#include "converter.h"
+#include "dct.h"
+#include "quantization.h"
+#include "zigzag.h"
+
+/**
+ * Fused per-block kernel: level shift, DCT, quantization and zig-zag.
+ * src points at the top-left Y sample of the 8x8 tile, stride is the row pitch.
+ * out receives the 64 quantized coefficients already in zig-zag order.
+ * engine selects the DCT, tables must hold the matching reciprocals.
+ * All intermediates live on the stack.
+ */
+void transformBlock(const uint8_t* src, int stride, DCTEngine engine, const QuantTables* tables, int16_t out[64]);
+
+/**
+ * Runs transformBlock over every 8x8 tile of an 8-row Y band.
+ * zzOut must hold band->width / 8 blocks.
+ */
+void transformBand(const YImage* band, DCTEngine engine, const QuantTables* tables, ZigZagData* zzOut);
+
+#endif
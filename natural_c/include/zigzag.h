@@ -11,7 +11,12 @@ typedef struct {
     int16_t *data;
 } ZigZagData;
 
+// Standard JPEG Zig-Zag order: ZIGZAG_ORDER[i] is the raster index of the i-th coefficient
+extern const uint8_t ZIGZAG_ORDER[64];
+
+ZigZagData* createZigZagData(int numBlocksW, int numBlocksH);
 ZigZagData* performZigZag(const QuantizedImage* qImg);
+void performZigZagInto(const QuantizedImage* qImg, ZigZagData* zzData);
 void freeZigZagData(ZigZagData* zData);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "arena.h"
+#include <stdlib.h>
+
+size_t arenaAllocationSize(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+Arena* createArena(size_t capacity) {
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    if (arena == NULL) return NULL;
+
+    arena->capacity = arenaAllocationSize(capacity);
+    arena->used = 0;
+    arena->base = NULL;
+
+    if (arena->capacity > 0) {
+        arena->base = (unsigned char*)aligned_alloc(ARENA_ALIGNMENT, arena->capacity);
+        if (arena->base == NULL) {
+            free(arena);
+            return NULL;
+        }
+    }
+
+    return arena;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    size_t bytes = arenaAllocationSize(size);
+    if (bytes > arena->capacity - arena->used) return NULL;
+
+    void* ptr = arena->base + arena->used;
+    arena->used += bytes;
+    return ptr;
+}
+
+void resetArena(Arena* arena) {
+    arena->used = 0;
+}
+
+void freeArena(Arena* arena) {
+    if (arena) {
+        free(arena->base);
+        free(arena);
+    }
+}
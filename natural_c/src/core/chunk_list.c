@@ -0,0 +1,173 @@
+#include "chunk_list.h"
+#include "ring_queue.h"
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+struct JpegPagePool {
+    RingQueue* freePages;
+};
+
+JpegPagePool* createJpegPagePool(int maxCachedPages) {
+    JpegPagePool* pool = (JpegPagePool*)malloc(sizeof(JpegPagePool));
+    if (pool == NULL) return NULL;
+
+    pool->freePages = createRingQueue(maxCachedPages > 0 ? maxCachedPages : 1);
+    if (pool->freePages == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void freeJpegPagePool(JpegPagePool* pool) {
+    if (pool) {
+        void* page;
+        while (tryPopRingQueue(pool->freePages, &page)) {
+            free(page);
+        }
+        freeRingQueue(pool->freePages);
+        free(pool);
+    }
+}
+
+static JpegPage* takePage(JpegPagePool* pool) {
+    void* reused;
+    JpegPage* page = tryPopRingQueue(pool->freePages, &reused) ? (JpegPage*)reused
+                                                               : (JpegPage*)malloc(sizeof(JpegPage));
+    if (page) {
+        page->next = NULL;
+        page->size = 0;
+    }
+    return page;
+}
+
+static void returnPage(JpegPagePool* pool, JpegPage* page) {
+    if (!tryPushRingQueue(pool->freePages, page)) {
+        free(page);
+    }
+}
+
+void initJpegChunkList(JpegChunkList* list, JpegPagePool* pool) {
+    list->pool = pool;
+    list->head = NULL;
+    list->tail = NULL;
+    list->size = 0;
+    list->numPages = 0;
+}
+
+bool appendJpegChunkList(JpegChunkList* list, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    while (size > 0) {
+        JpegPage* page = list->tail;
+
+        if (page == NULL || page->size == JPEG_PAGE_SIZE) {
+            page = takePage(list->pool);
+            if (page == NULL) return false;
+
+            if (list->tail) {
+                list->tail->next = page;
+            } else {
+                list->head = page;
+            }
+            list->tail = page;
+            list->numPages++;
+        }
+
+        size_t room = JPEG_PAGE_SIZE - page->size;
+        size_t count = size < room ? size : room;
+
+        memcpy(page->data + page->size, bytes, count);
+        page->size += count;
+        list->size += count;
+        bytes += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+void spliceJpegChunkList(JpegChunkList* dst, JpegChunkList* src) {
+    if (src->head == NULL) return;
+
+    if (dst->tail) {
+        dst->tail->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    dst->tail = src->tail;
+    dst->size += src->size;
+    dst->numPages += src->numPages;
+
+    src->head = NULL;
+    src->tail = NULL;
+    src->size = 0;
+    src->numPages = 0;
+}
+
+void clearJpegChunkList(JpegChunkList* list) {
+    JpegPage* page = list->head;
+    while (page) {
+        JpegPage* next = page->next;
+        returnPage(list->pool, page);
+        page = next;
+    }
+
+    list->head = NULL;
+    list->tail = NULL;
+    list->size = 0;
+    list->numPages = 0;
+}
+
+// Writes all of iov, continuing after short writes
+static bool writeVectors(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        // Skip what went out; a partially written vector is advanced in place
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return true;
+}
+
+bool writeJpegChunkList(int fd, const void* prefix, size_t prefixSize, const JpegChunkList* list) {
+    struct iovec iov[IOV_MAX];
+    int count = 0;
+
+    if (prefix && prefixSize > 0) {
+        iov[count].iov_base = (void*)prefix;
+        iov[count].iov_len = prefixSize;
+        count++;
+    }
+
+    for (const JpegPage* page = list->head; page; page = page->next) {
+        if (count == IOV_MAX) {
+            if (!writeVectors(fd, iov, count)) return false;
+            count = 0;
+        }
+        iov[count].iov_base = (void*)page->data;
+        iov[count].iov_len = page->size;
+        count++;
+    }
+
+    return writeVectors(fd, iov, count);
+}
@@ -1,90 +1,263 @@
 #include "converter.h"
+#include "kernels.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-YImage* convertBMPToJPEGGrayscale(const BMPImage* image) {
-    
-    if (image == NULL || image->data == NULL) {
-        return NULL;
-    }
+
+YImage* createYImage(int width, int height) {
 
     YImage* yImg = (YImage*)malloc(sizeof(YImage));
     if (yImg == NULL) {
-        return NULL; 
+        return NULL;
     }
 
-    int paddedWidth = (image->width + 7) & (~7);
-    int paddedHeight = (image->height + 7) & (~7);
-
-    yImg->width = paddedWidth;
-    yImg->height = paddedHeight;
-    
-    // Allocate memory for the PADDED size
-    yImg->data = (uint8_t*)malloc(paddedWidth * paddedHeight * sizeof(uint8_t));
+    yImg->width = width;
+    yImg->height = height;
+    yImg->data = (uint8_t*)malloc(width * height * sizeof(uint8_t));
 
     if (yImg->data == NULL) {
         free(yImg);
         return NULL;
     }
-    for (int y = 0; y < paddedHeight; y++) {
-        // Clamp the Y coordinate to the original image height.
-        // If y >= original height, we repeat the last row.
-        int srcY = MIN(y, image->height - 1);
 
-        for (int x = 0; x < paddedWidth; x++) {
-            // Clamp the X coordinate to the original image width.
-            // If x >= original width, we repeat the last pixel of the row.
-            int srcX = MIN(x, image->width - 1);
+    return yImg;
+}
 
-            // Calculate index in the source (RGB) buffer
-            int srcIndex = (srcY * image->width + srcX) * 3;
+// Integer BT.601 weights (multiplied by 256)
+#define Y_WEIGHT_R 77
+#define Y_WEIGHT_G 150
+#define Y_WEIGHT_B 29
 
-            // Calculate index in the destination (Y) buffer
-            int dstIndex = y * paddedWidth + x;
+// w0 and w2 weigh the first and last byte of each pixel, so one body serves
+// RGB and BGR rows; G is always in the middle
+static inline void convertRowToY(const uint8_t* px, int count, uint8_t* yRow, int w0, int w2) {
 
-            uint8_t r = image->data[srcIndex];     
-            uint8_t g = image->data[srcIndex + 1];
-            uint8_t b = image->data[srcIndex + 2];
+    for (int x = 0; x < count; x++) {
+        uint8_t c0 = px[x * 3];
+        uint8_t g = px[x * 3 + 1];
+        uint8_t c2 = px[x * 3 + 2];
 
-            // Original: Y = 0.299*R + 0.587*G + 0.114*B
-            // Optimized whole number approximation (multiplied by 256):
-            // Y = (77*R + 150*G + 29*B) >> 8
-            uint32_t yVal = (77 * r + 150 * g + 29 * b) >> 8;
+        // Original: Y = 0.299*R + 0.587*G + 0.114*B
+        // Optimized whole number approximation (multiplied by 256):
+        // Y = (77*R + 150*G + 29*B) >> 8
+        uint32_t yVal = (w0 * c0 + Y_WEIGHT_G * g + w2 * c2) >> 8;
 
-            yImg->data[dstIndex] = (uint8_t) yVal;
-        }
+        yRow[x] = (uint8_t) yVal;
     }
+}
 
-    return yImg;
+void convertRGBRowToY(const uint8_t* rgb, int count, uint8_t* yRow) {
+    convertRowToY(rgb, count, yRow, Y_WEIGHT_R, Y_WEIGHT_B);
 }
 
-CenteredYImage* centerYImage(const YImage* source) {
+void convertBGRRowToY(const uint8_t* bgr, int count, uint8_t* yRow) {
+    convertRowToY(bgr, count, yRow, Y_WEIGHT_B, Y_WEIGHT_R);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// pshufb masks that pick bytes 0, 1 and 2 of 8 packed 3-byte pixels into
+// zero-extended 16-bit lanes. The first mask of each pair indexes bytes
+// 0..15, the second bytes 16..23 (loaded separately); -1 writes a zero.
+static const int8_t SHUF_C0_LO[16] = { 0, -1, 3, -1, 6, -1, 9, -1, 12, -1, 15, -1, -1, -1, -1, -1 };
+static const int8_t SHUF_C0_HI[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, -1, 5, -1 };
+static const int8_t SHUF_C1_LO[16] = { 1, -1, 4, -1, 7, -1, 10, -1, 13, -1, -1, -1, -1, -1, -1, -1 };
+static const int8_t SHUF_C1_HI[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, -1, 3, -1, 6, -1 };
+static const int8_t SHUF_C2_LO[16] = { 2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1 };
+static const int8_t SHUF_C2_HI[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, -1, 4, -1, 7, -1 };
+
+__attribute__((target("ssse3")))
+static inline void convertRowToYSSSE3(const uint8_t* px, int count, uint8_t* yRow, int w0, int w2) {
+
+    const __m128i c0Lo = _mm_loadu_si128((const __m128i*)SHUF_C0_LO);
+    const __m128i c0Hi = _mm_loadu_si128((const __m128i*)SHUF_C0_HI);
+    const __m128i gLo = _mm_loadu_si128((const __m128i*)SHUF_C1_LO);
+    const __m128i gHi = _mm_loadu_si128((const __m128i*)SHUF_C1_HI);
+    const __m128i c2Lo = _mm_loadu_si128((const __m128i*)SHUF_C2_LO);
+    const __m128i c2Hi = _mm_loadu_si128((const __m128i*)SHUF_C2_HI);
+    const __m128i wc0 = _mm_set1_epi16((short)w0);
+    const __m128i wg = _mm_set1_epi16(Y_WEIGHT_G);
+    const __m128i wc2 = _mm_set1_epi16((short)w2);
+
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        // 8 pixels = 24 bytes, loaded as 16 + 8 so nothing past the row is touched
+        __m128i lo = _mm_loadu_si128((const __m128i*)&px[x * 3]);
+        __m128i hi = _mm_loadl_epi64((const __m128i*)&px[x * 3 + 16]);
+
+        __m128i c0 = _mm_or_si128(_mm_shuffle_epi8(lo, c0Lo), _mm_shuffle_epi8(hi, c0Hi));
+        __m128i g = _mm_or_si128(_mm_shuffle_epi8(lo, gLo), _mm_shuffle_epi8(hi, gHi));
+        __m128i c2 = _mm_or_si128(_mm_shuffle_epi8(lo, c2Lo), _mm_shuffle_epi8(hi, c2Hi));
+
+        // 77*R + 150*G + 29*B <= 65280, so unsigned 16-bit lanes do not overflow
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(c0, wc0),
+                      _mm_add_epi16(_mm_mullo_epi16(g, wg), _mm_mullo_epi16(c2, wc2)));
+        sum = _mm_srli_epi16(sum, 8);
+
+        _mm_storel_epi64((__m128i*)&yRow[x], _mm_packus_epi16(sum, sum));
+    }
+
+    convertRowToY(&px[x * 3], count - x, &yRow[x], w0, w2);
+}
+
+__attribute__((target("ssse3")))
+void convertRGBRowToYSSSE3(const uint8_t* rgb, int count, uint8_t* yRow) {
+    convertRowToYSSSE3(rgb, count, yRow, Y_WEIGHT_R, Y_WEIGHT_B);
+}
+
+__attribute__((target("ssse3")))
+void convertBGRRowToYSSSE3(const uint8_t* bgr, int count, uint8_t* yRow) {
+    convertRowToYSSSE3(bgr, count, yRow, Y_WEIGHT_B, Y_WEIGHT_R);
+}
+
+__attribute__((target("avx2")))
+static inline void convertRowToYAVX2(const uint8_t* px, int count, uint8_t* yRow, int w0, int w2) {
+
+    // Same shuffles as the SSSE3 kernel, one group of 8 pixels per 128-bit lane
+    const __m256i c0Lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUF_C0_LO));
+    const __m256i c0Hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUF_C0_HI));
+    const __m256i gLo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUF_C1_LO));
+    const __m256i gHi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUF_C1_HI));
+    const __m256i c2Lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUF_C2_LO));
+    const __m256i c2Hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)SHUF_C2_HI));
+    const __m256i wc0 = _mm256_set1_epi16((short)w0);
+    const __m256i wg = _mm256_set1_epi16(Y_WEIGHT_G);
+    const __m256i wc2 = _mm256_set1_epi16((short)w2);
+
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        const uint8_t* p = &px[x * 3];
+        __m256i lo = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                         _mm_loadu_si128((const __m128i*)p)),
+                         _mm_loadu_si128((const __m128i*)(p + 24)), 1);
+        __m256i hi = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                         _mm_loadl_epi64((const __m128i*)(p + 16))),
+                         _mm_loadl_epi64((const __m128i*)(p + 40)), 1);
+
+        __m256i c0 = _mm256_or_si256(_mm256_shuffle_epi8(lo, c0Lo), _mm256_shuffle_epi8(hi, c0Hi));
+        __m256i g = _mm256_or_si256(_mm256_shuffle_epi8(lo, gLo), _mm256_shuffle_epi8(hi, gHi));
+        __m256i c2 = _mm256_or_si256(_mm256_shuffle_epi8(lo, c2Lo), _mm256_shuffle_epi8(hi, c2Hi));
+
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(c0, wc0),
+                      _mm256_add_epi16(_mm256_mullo_epi16(g, wg), _mm256_mullo_epi16(c2, wc2)));
+        sum = _mm256_srli_epi16(sum, 8);
+
+        // Lane 0 holds pixels 0..7, lane 1 pixels 8..15
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        _mm_storeu_si128((__m128i*)&yRow[x], packed);
+    }
+
+    convertRowToYSSSE3(&px[x * 3], count - x, &yRow[x], w0, w2);
+}
+
+__attribute__((target("avx2")))
+void convertRGBRowToYAVX2(const uint8_t* rgb, int count, uint8_t* yRow) {
+    convertRowToYAVX2(rgb, count, yRow, Y_WEIGHT_R, Y_WEIGHT_B);
+}
+
+__attribute__((target("avx2")))
+void convertBGRRowToYAVX2(const uint8_t* bgr, int count, uint8_t* yRow) {
+    convertRowToYAVX2(bgr, count, yRow, Y_WEIGHT_B, Y_WEIGHT_R);
+}
+
+#endif
+
+void convertBMPRowsToY(const BMPImage* image, int startRow, YImage* band) {
+
+    if (image == NULL || !hasBMPImagePixels(image) || band == NULL || band->data == NULL) {
+        return;
+    }
+
+    // Mapped files are read in place, in the file's BGR order
+    const JpegKernels* kernels = getJpegKernels();
+    ColorConvertRowFn convertRow = image->channelOrder == BMP_CHANNELS_BGR
+                                 ? kernels->colorConvertBGRRow : kernels->colorConvertRow;
+    int copyWidth = MIN(band->width, image->width);
+
+    for (int y = 0; y < band->height; y++) {
+        // Clamp the Y coordinate to the original image height.
+        // If y >= original height, we repeat the last row.
+        int srcY = MIN(startRow + y, image->height - 1);
+        uint8_t* dstRow = &band->data[y * band->width];
+
+        convertRow(getBMPImageRow(image, srcY), copyWidth, dstRow);
+
+        // Columns past the original width repeat the last pixel of the row
+        for (int x = copyWidth; x < band->width; x++) {
+            dstRow[x] = dstRow[copyWidth - 1];
+        }
+    }
+}
+
+YImage* convertBMPToJPEGGrayscale(const BMPImage* image) {
     
-    if (source == NULL || source->data == NULL) {
+    if (image == NULL || !hasBMPImagePixels(image)) {
         return NULL;
     }
 
+    int paddedWidth = (image->width + 7) & (~7);
+    int paddedHeight = (image->height + 7) & (~7);
+
+    // Allocate memory for the PADDED size
+    YImage* yImg = createYImage(paddedWidth, paddedHeight);
+    if (yImg == NULL) {
+        return NULL; 
+    }
+
+    convertBMPRowsToY(image, 0, yImg);
+
+    return yImg;
+}
+
+CenteredYImage* createCenteredYImage(int width, int height) {
+
     CenteredYImage* centeredImg = (CenteredYImage*)malloc(sizeof(CenteredYImage));
     if (centeredImg == NULL) {
         return NULL;
     }
 
-    centeredImg->width = source->width;
-    centeredImg->height = source->height;
-
-    int totalPixels = source->width * source->height;
-    centeredImg->data = (int8_t*)malloc(totalPixels * sizeof(int8_t));
+    centeredImg->width = width;
+    centeredImg->height = height;
+    centeredImg->data = (int8_t*)malloc(width * height * sizeof(int8_t));
 
     if (centeredImg->data == NULL) {
         free(centeredImg); // Cleanup struct allocation
         return NULL;
     }
 
+    return centeredImg;
+}
+
+void centerYImageInto(const YImage* source, CenteredYImage* dest) {
+
+    if (source == NULL || source->data == NULL || dest == NULL || dest->data == NULL) {
+        return;
+    }
+
+    int totalPixels = source->width * source->height;
+
     // Perform Level Shifting
     for (int i = 0; i < totalPixels; i++) {
         int shiftedValue = (int)source->data[i] - 128;
         
-        centeredImg->data[i] = (int8_t)shiftedValue;
+        dest->data[i] = (int8_t)shiftedValue;
     }
+}
+
+CenteredYImage* centerYImage(const YImage* source) {
+    
+    if (source == NULL || source->data == NULL) {
+        return NULL;
+    }
+
+    CenteredYImage* centeredImg = createCenteredYImage(source->width, source->height);
+    if (centeredImg == NULL) {
+        return NULL;
+    }
+
+    centerYImageInto(source, centeredImg);
 
     return centeredImg;
 }
@@ -1,4 +1,9 @@
 #include "dct.h"
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 // Table for C(u) and C(v) scaling factors
 static const float C_LUT[8] = {
@@ -59,8 +64,47 @@ void initDCTTables()
 */
 
 
+// Cosine basis of the DCT-II: DCT_T[u][x] = cos((2x + 1) * u * PI / 16), with row 0 set to 1.
+// The C(u) normalization is applied afterwards through DCT_SCALE, so the DC term is an
+// exact integer sum and flat blocks quantize exactly like the direct formula.
+// Same matrix formulation as the C7x port (dsp_port/jpeg_compression/src/dct.c).
+static const float DCT_T[64] = {
+     1.000000000f,  1.000000000f,  1.000000000f,  1.000000000f,  1.000000000f,  1.000000000f,  1.000000000f,  1.000000000f,
+     0.980785280f,  0.831469612f,  0.555570233f,  0.195090322f, -0.195090322f, -0.555570233f, -0.831469612f, -0.980785280f,
+     0.923879533f,  0.382683432f, -0.382683432f, -0.923879533f, -0.923879533f, -0.382683432f,  0.382683432f,  0.923879533f,
+     0.831469612f, -0.195090322f, -0.980785280f, -0.555570233f,  0.555570233f,  0.980785280f,  0.195090322f, -0.831469612f,
+     0.707106781f, -0.707106781f, -0.707106781f,  0.707106781f,  0.707106781f, -0.707106781f, -0.707106781f,  0.707106781f,
+     0.555570233f, -0.980785280f,  0.195090322f,  0.831469612f, -0.831469612f, -0.195090322f,  0.980785280f, -0.555570233f,
+     0.382683432f, -0.923879533f,  0.923879533f, -0.382683432f, -0.382683432f,  0.923879533f, -0.923879533f,  0.382683432f,
+     0.195090322f, -0.555570233f,  0.831469612f, -0.980785280f,  0.980785280f, -0.831469612f,  0.555570233f, -0.195090322f
+};
 
-void computeDCTBlock(const int8_t inputBlock[8][8], float outputBlock[8][8])
+static const float DCT_T_TRANSPOSED[64] = {
+     1.000000000f,  0.980785280f,  0.923879533f,  0.831469612f,  0.707106781f,  0.555570233f,  0.382683432f,  0.195090322f,
+     1.000000000f,  0.831469612f,  0.382683432f, -0.195090322f, -0.707106781f, -0.980785280f, -0.923879533f, -0.555570233f,
+     1.000000000f,  0.555570233f, -0.382683432f, -0.980785280f, -0.707106781f,  0.195090322f,  0.923879533f,  0.831469612f,
+     1.000000000f,  0.195090322f, -0.923879533f, -0.555570233f,  0.707106781f,  0.831469612f, -0.382683432f, -0.980785280f,
+     1.000000000f, -0.195090322f, -0.923879533f,  0.555570233f,  0.707106781f, -0.831469612f, -0.382683432f,  0.980785280f,
+     1.000000000f, -0.555570233f, -0.382683432f,  0.980785280f, -0.707106781f, -0.195090322f,  0.923879533f, -0.831469612f,
+     1.000000000f, -0.831469612f,  0.382683432f,  0.195090322f, -0.707106781f,  0.980785280f, -0.923879533f,  0.555570233f,
+     1.000000000f, -0.980785280f,  0.923879533f, -0.831469612f,  0.707106781f, -0.555570233f,  0.382683432f, -0.195090322f
+};
+
+// Output scaling: DCT_SCALE[u][v] = C(u) * C(v) / 4, with C(0) = 1/sqrt(2) and C(u) = 1 otherwise
+static const float DCT_SCALE[64] = {
+     0.125000000f,  0.176776695f,  0.176776695f,  0.176776695f,  0.176776695f,  0.176776695f,  0.176776695f,  0.176776695f,
+     0.176776695f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,
+     0.176776695f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,
+     0.176776695f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,
+     0.176776695f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,
+     0.176776695f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,
+     0.176776695f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,
+     0.176776695f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f,  0.250000000f
+};
+
+// Direct evaluation of the 2-D DCT formula (4096 multiply-adds per block).
+// No longer used by the encoder, kept as the reference for dct_bench.
+void computeDCTBlockDirect(const int8_t inputBlock[8][8], float outputBlock[8][8])
 {
     for (int u = 0; u < 8; u++)
     {
@@ -95,19 +139,343 @@ void computeDCTBlock(const int8_t inputBlock[8][8], float outputBlock[8][8])
     }
 }
 
-DCTImage *performDCT(const CenteredYImage *image)
+/**
+ * Standard Matrix Multiplication 8x8 (C = A * B).
+ * The inner loop runs along a row of B and C so the compiler can vectorize it.
+ */
+static inline void matrixMul8x8(const float *restrict A, const float *restrict B, float *restrict C)
 {
+    for (int i = 0; i < 8; i++)
+    {
+        float row[8] = {0.0f};
 
-    if (image == NULL || image->data == NULL)
-        return NULL;
+        for (int k = 0; k < 8; k++)
+        {
+            float a = A[i * 8 + k];
+            for (int j = 0; j < 8; j++)
+            {
+                row[j] += a * B[k * 8 + j];
+            }
+        }
+
+        for (int j = 0; j < 8; j++)
+        {
+            C[i * 8 + j] = row[j];
+        }
+    }
+}
+
+// Separable form of the 2-D DCT: F = S .* (T * X * T').
+// The first pass transforms the rows, the second the columns,
+// for 1024 multiply-adds per block instead of 4096 (plus 64 for the scaling).
+void computeDCTBlock(const int8_t inputBlock[8][8], float outputBlock[8][8])
+{
+    float block[64];
+    float temp[64];
+    float result[64];
+
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            block[y * 8 + x] = (float)inputBlock[y][x];
+        }
+    }
+
+    // Rows: Temp = X * T'
+    matrixMul8x8(block, DCT_T_TRANSPOSED, temp);
+
+    // Columns: Result = T * Temp
+    matrixMul8x8(DCT_T, temp, result);
+
+    // Apply the C(u) * C(v) / 4 normalization
+    float *out = &outputBlock[0][0];
+    for (int i = 0; i < 64; i++)
+    {
+        out[i] = result[i] * DCT_SCALE[i];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Transposes an 8x8 float matrix held in eight AVX registers
+__attribute__((target("avx2,fma")))
+static inline void transpose8x8AVX2(__m256 r[8])
+{
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// out[u] = sum over k of DCT_T[u][k] * in[k]: one 1-D DCT pass over all eight columns at once.
+// The k loop is outermost so the eight accumulators form independent FMA chains.
+__attribute__((target("avx2,fma")))
+static inline void dctPassAVX2(const __m256 in[8], __m256 out[8])
+{
+    #pragma GCC unroll 8
+    for (int u = 0; u < 8; u++)
+    {
+        out[u] = _mm256_mul_ps(_mm256_broadcast_ss(&DCT_T[u * 8]), in[0]);
+    }
+
+    #pragma GCC unroll 8
+    for (int k = 1; k < 8; k++)
+    {
+        #pragma GCC unroll 8
+        for (int u = 0; u < 8; u++)
+        {
+            out[u] = _mm256_fmadd_ps(_mm256_broadcast_ss(&DCT_T[u * 8 + k]), in[k], out[u]);
+        }
+    }
+}
+
+// AVX2 + FMA version of computeDCTBlock. One register holds one row of the block,
+// both passes are 64 FMAs, and the block is transposed in registers between them.
+__attribute__((target("avx2,fma")))
+void computeDCTBlockAVX2(const int8_t inputBlock[8][8], float outputBlock[8][8])
+{
+    __m256 rows[8];
+    __m256 temp[8];
+
+    // int8 -> float, one row per register
+    for (int y = 0; y < 8; y++)
+    {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)inputBlock[y]);
+        rows[y] = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+    }
+
+    // Columns: Temp = T * X
+    dctPassAVX2(rows, temp);
+
+    // Rows: F' = T * Temp' (the transpose of Temp * T')
+    transpose8x8AVX2(temp);
+    dctPassAVX2(temp, rows);
+    transpose8x8AVX2(rows);
+
+    // Apply the C(u) * C(v) / 4 normalization
+    for (int u = 0; u < 8; u++)
+    {
+        __m256 scaled = _mm256_mul_ps(rows[u], _mm256_loadu_ps(&DCT_SCALE[u * 8]));
+        _mm256_storeu_ps(outputBlock[u], scaled);
+    }
+}
+
+#endif
+
+// Forward DCT after Arai, Agui and Nakajima (as in the IJG float DCT).
+// The 1-D transform needs only 5 multiplies; the remaining per-coefficient
+// scaling is left in the output and folded into the quantization divisors
+// (see AAN_SCALE_FACTOR in quantization.c).
+static inline void aan1D(float *d, int stride)
+{
+    float tmp0 = d[0 * stride] + d[7 * stride];
+    float tmp7 = d[0 * stride] - d[7 * stride];
+    float tmp1 = d[1 * stride] + d[6 * stride];
+    float tmp6 = d[1 * stride] - d[6 * stride];
+    float tmp2 = d[2 * stride] + d[5 * stride];
+    float tmp5 = d[2 * stride] - d[5 * stride];
+    float tmp3 = d[3 * stride] + d[4 * stride];
+    float tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    float tmp10 = tmp0 + tmp3;
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+
+    d[0 * stride] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
 
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = 0.541196100f * tmp10 + z5;
+    float z4 = 1.306562965f * tmp12 + z5;
+    float z3 = tmp11 * 0.707106781f;
+
+    float z11 = tmp7 + z3;
+    float z13 = tmp7 - z3;
+
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[1 * stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+void computeDCTBlockAAN(const int8_t inputBlock[8][8], float outputBlock[8][8])
+{
+    float *out = &outputBlock[0][0];
+
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            out[y * 8 + x] = (float)inputBlock[y][x];
+        }
+    }
+
+    // Rows
+    for (int y = 0; y < 8; y++)
+    {
+        aan1D(&out[y * 8], 1);
+    }
+
+    // Columns
+    for (int x = 0; x < 8; x++)
+    {
+        aan1D(&out[x], 8);
+    }
+}
+
+// Fixed-point constants for the integer DCT: round(x * 2^CONST_BITS)
+#define CONST_BITS 13
+#define PASS1_BITS 2
+
+#define FIX_0_298631336 ((int32_t)2446)
+#define FIX_0_390180644 ((int32_t)3196)
+#define FIX_0_541196100 ((int32_t)4433)
+#define FIX_0_765366865 ((int32_t)6270)
+#define FIX_0_899976223 ((int32_t)7373)
+#define FIX_1_175875602 ((int32_t)9633)
+#define FIX_1_501321110 ((int32_t)12299)
+#define FIX_1_847759065 ((int32_t)15137)
+#define FIX_1_961570560 ((int32_t)16069)
+#define FIX_2_053119869 ((int32_t)16819)
+#define FIX_2_562915447 ((int32_t)20995)
+#define FIX_3_072711026 ((int32_t)25172)
+
+// Right shift with rounding
+#define DESCALE(x, n) (((x) + ((int32_t)1 << ((n) - 1))) >> (n))
+
+// One in-place 1-D pass of the Loeffler-Ligtenberg-Moschytz integer DCT (as in the IJG "islow" DCT).
+// Products are descaled by 'shift' bits. The DC/4 terms have no multiply: the row pass
+// scales them up by 2^PASS1_BITS (dcShift < 0), the column pass rounds them down (dcShift > 0).
+static inline void intDCT1D(int32_t *d, int stride, int shift, int dcShift)
+{
+    int32_t tmp0 = d[0 * stride] + d[7 * stride];
+    int32_t tmp7 = d[0 * stride] - d[7 * stride];
+    int32_t tmp1 = d[1 * stride] + d[6 * stride];
+    int32_t tmp6 = d[1 * stride] - d[6 * stride];
+    int32_t tmp2 = d[2 * stride] + d[5 * stride];
+    int32_t tmp5 = d[2 * stride] - d[5 * stride];
+    int32_t tmp3 = d[3 * stride] + d[4 * stride];
+    int32_t tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+
+    if (dcShift > 0)
+    {
+        d[0 * stride] = DESCALE(tmp10 + tmp11, dcShift);
+        d[4 * stride] = DESCALE(tmp10 - tmp11, dcShift);
+    }
+    else
+    {
+        d[0 * stride] = (tmp10 + tmp11) * (1 << -dcShift);
+        d[4 * stride] = (tmp10 - tmp11) * (1 << -dcShift);
+    }
+
+    int32_t z1 = (tmp12 + tmp13) * FIX_0_541196100;
+    d[2 * stride] = DESCALE(z1 + tmp13 * FIX_0_765366865, shift);
+    d[6 * stride] = DESCALE(z1 - tmp12 * FIX_1_847759065, shift);
+
+    // Odd part
+    z1 = tmp4 + tmp7;
+    int32_t z2 = tmp5 + tmp6;
+    int32_t z3 = tmp4 + tmp6;
+    int32_t z4 = tmp5 + tmp7;
+    int32_t z5 = (z3 + z4) * FIX_1_175875602;
+
+    tmp4 *= FIX_0_298631336;
+    tmp5 *= FIX_2_053119869;
+    tmp6 *= FIX_3_072711026;
+    tmp7 *= FIX_1_501321110;
+    z1 *= -FIX_0_899976223;
+    z2 *= -FIX_2_562915447;
+    z3 = z3 * -FIX_1_961570560 + z5;
+    z4 = z4 * -FIX_0_390180644 + z5;
+
+    d[7 * stride] = DESCALE(tmp4 + z1 + z3, shift);
+    d[5 * stride] = DESCALE(tmp5 + z2 + z4, shift);
+    d[3 * stride] = DESCALE(tmp6 + z2 + z3, shift);
+    d[1 * stride] = DESCALE(tmp7 + z1 + z4, shift);
+}
+
+void computeDCTBlockInt(const int8_t inputBlock[8][8], int16_t outputBlock[8][8])
+{
+    int32_t workspace[64];
+
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            workspace[y * 8 + x] = inputBlock[y][x];
+        }
+    }
+
+    // Rows: results are scaled up by 2^PASS1_BITS
+    for (int y = 0; y < 8; y++)
+    {
+        intDCT1D(&workspace[y * 8], 1, CONST_BITS - PASS1_BITS, -PASS1_BITS);
+    }
+
+    // Columns: remove the PASS1_BITS again, leaving the output scaled by 8
+    for (int x = 0; x < 8; x++)
+    {
+        intDCT1D(&workspace[x], 8, CONST_BITS + PASS1_BITS, PASS1_BITS);
+    }
+
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            outputBlock[y][x] = (int16_t)workspace[y * 8 + x];
+        }
+    }
+}
+
+DCTImage *createDCTImage(int width, int height)
+{
     DCTImage *dctImg = (DCTImage *)malloc(sizeof(DCTImage));
     if (dctImg == NULL)
         return NULL;
 
-    dctImg->width = image->width;
-    dctImg->height = image->height;
-    dctImg->coefficients = (float *)malloc(image->width * image->height * sizeof(float));
+    dctImg->width = width;
+    dctImg->height = height;
+    dctImg->coefficients = (float *)malloc(width * height * sizeof(float));
 
     if (dctImg->coefficients == NULL)
     {
@@ -115,6 +483,16 @@ DCTImage *performDCT(const CenteredYImage *image)
         return NULL;
     }
 
+    return dctImg;
+}
+
+void performDCTInto(const CenteredYImage *image, DCTImage *dctImg)
+{
+    if (image == NULL || image->data == NULL || dctImg == NULL || dctImg->coefficients == NULL)
+        return;
+
+    DCTBlockFn dctBlockFn = getJpegKernels()->dctBlock;
+
     // Loop through blocks
     for (int y = 0; y <= image->height - 8; y += 8)
     {
@@ -134,7 +512,7 @@ DCTImage *performDCT(const CenteredYImage *image)
             }
 
             // Compute DCT
-            computeDCTBlock(tempBlock, dctBlock);
+            dctBlockFn(tempBlock, dctBlock);
 
             // Store result
             for (int by = 0; by < 8; by++)
@@ -146,6 +524,19 @@ DCTImage *performDCT(const CenteredYImage *image)
             }
         }
     }
+}
+
+DCTImage *performDCT(const CenteredYImage *image)
+{
+
+    if (image == NULL || image->data == NULL)
+        return NULL;
+
+    DCTImage *dctImg = createDCTImage(image->width, image->height);
+    if (dctImg == NULL)
+        return NULL;
+
+    performDCTInto(image, dctImg);
 
     return dctImg;
 }
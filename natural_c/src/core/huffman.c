@@ -1,194 +1,649 @@
 #include "huffman.h"
-#include "jpeg_tables.h"
 #include <string.h>
 #include <stdio.h>
 
-// Lookup tables: 
-// dcTable maps a category (0-11) to a code.
-// acTable maps a symbol (Run/Size byte) to a code.
-static HuffmanCode dcTable[16];
-static HuffmanCode acTable[256];
-static int tablesInitialized = 0;
-
-
-// Grows the buffer if needed
-static void ensureCapacity(JpegEncoderBuffer* buf, size_t extra) {
-    if (buf->size + extra >= buf->capacity) {
-        size_t newCap = buf->capacity == 0 ? 1024 : buf->capacity * 2;
-        if (newCap < buf->size + extra) newCap = buf->size + extra + 1024;
-        buf->data = (uint8_t*)realloc(buf->data, newCap);
-        buf->capacity = newCap;
-    }
-}
-
-// Writes a single byte to the buffer, handling JPEG Byte Stuffing
-// Rule: If we write 0xFF, we must follow it with 0x00.
-static void writeByte(JpegEncoderBuffer* buf, uint8_t byte) {
-    ensureCapacity(buf, 2);
-    buf->data[buf->size++] = byte;
-    if (byte == 0xFF) {
-        buf->data[buf->size++] = 0x00;
-    }
-}
-
-// Pushes bits into the accumulator. When 8 bits accumulate, writes to buffer.
-static void putBits(BitWriter* bw, uint16_t data, uint8_t numBits) {
-    if (numBits == 0) return;
-
-    // Mask data just in case
-    data &= (1 << numBits) - 1;
-
-    // Add bits to top of accumulator
-    // JPEG writes MSB first.
-    // We shift current bits left to make room, but here we construct 
-    // the byte from top down.
-    
-    // Standard approach: Keep bits in a 32-bit integer, aligned to the left or right.
-    // Here: We align to the left (MSB).
-    
-    // Let's use a simpler approach often used in JPEG encoders:
-    // Accumulator fills from MSB.
-    
-    bw->accumulator |= ((uint32_t)data << (32 - bw->bitCount - numBits));
-    bw->bitCount += numBits;
-
-    while (bw->bitCount >= 8) {
-        uint8_t byte = (bw->accumulator >> 24) & 0xFF;
-        writeByte(bw->buffer, byte);
-        
-        bw->accumulator <<= 8;
-        bw->bitCount -= 8;
-    }
-}
-
-// Flushes remaining bits (pads with 1s)
-static void flushBits(BitWriter* bw) {
-    if (bw->bitCount > 0) {
-        // Pad with 1s (standard says pad with 1s, though 0s often work too)
-        // Since we are shifting 0s in from right, we need to OR with 1s for the padding.
-        // Actually, simple padding with 0 (what remains in accumulator) is usually fine
-        // as long as we align to byte boundary. 
-        // But to be safe with `0xFF` stuffing at the end, let's just write what we have.
-        
-        uint8_t byte = (bw->accumulator >> 24) & 0xFF;
-        
-        // Mask the valid bits. The rest are 0s from the shift.
-        // If we want 1-padding, we'd OR the lower bits. 
-        // For this example, 0-padding the last byte is acceptable.
-        
-        writeByte(bw->buffer, byte);
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Annex K.3 luminance tables (std_dc_luminance_* / std_ac_luminance_* in
+// canonical order), laid out as described in huffman.h. Unused symbols are { 0, 0 }.
+const HuffmanTables STD_HUFFMAN_TABLES = {
+    .dc = {
+        { 0x0, 2 }, { 0x4, 4 }, { 0xC, 5 }, { 0x20, 6 },
+        { 0x50, 7 }, { 0xC0, 8 }, { 0x380, 10 }, { 0xF00, 12 },
+        { 0x3E00, 14 }, { 0xFC00, 16 }, { 0x3F800, 18 }, { 0xFF000, 20 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+    },
+    .ac = {
+        // Run 0
+        { 0xA, 4 }, { 0x0, 3 }, { 0x4, 4 }, { 0x20, 6 },
+        { 0xB0, 8 }, { 0x340, 10 }, { 0x1E00, 13 }, { 0x7C00, 15 },
+        { 0x3F600, 18 }, { 0x1FF0400, 25 }, { 0x3FE0C00, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 1
+        { 0, 0 }, { 0x18, 5 }, { 0x6C, 7 }, { 0x3C8, 10 },
+        { 0x1F60, 13 }, { 0xFEC0, 16 }, { 0x3FE100, 22 }, { 0x7FC280, 23 },
+        { 0xFF8600, 24 }, { 0x1FF0E00, 25 }, { 0x3FE2000, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 2
+        { 0, 0 }, { 0x38, 6 }, { 0x3E4, 10 }, { 0x1FB8, 13 },
+        { 0xFF40, 16 }, { 0x1FF120, 21 }, { 0x3FE280, 22 }, { 0x7FC580, 23 },
+        { 0xFF8C00, 24 }, { 0x1FF1A00, 25 }, { 0x3FE3800, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 3
+        { 0, 0 }, { 0x74, 7 }, { 0x7DC, 11 }, { 0x7FA8, 15 },
+        { 0xFF8F0, 20 }, { 0x1FF200, 21 }, { 0x3FE440, 22 }, { 0x7FC900, 23 },
+        { 0xFF9300, 24 }, { 0x1FF2800, 25 }, { 0x3FE5400, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 4
+        { 0, 0 }, { 0x76, 7 }, { 0xFE0, 12 }, { 0x7FCB0, 19 },
+        { 0xFF970, 20 }, { 0x1FF300, 21 }, { 0x3FE640, 22 }, { 0x7FCD00, 23 },
+        { 0xFF9B00, 24 }, { 0x1FF3800, 25 }, { 0x3FE7400, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 5
+        { 0, 0 }, { 0xF4, 8 }, { 0x1FDC, 13 }, { 0x7FCF0, 19 },
+        { 0xFF9F0, 20 }, { 0x1FF400, 21 }, { 0x3FE840, 22 }, { 0x7FD100, 23 },
+        { 0xFFA300, 24 }, { 0x1FF4800, 25 }, { 0x3FE9400, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 6
+        { 0, 0 }, { 0xF6, 8 }, { 0x3FD8, 14 }, { 0x7FD30, 19 },
+        { 0xFFA70, 20 }, { 0x1FF500, 21 }, { 0x3FEA40, 22 }, { 0x7FD500, 23 },
+        { 0xFFAB00, 24 }, { 0x1FF5800, 25 }, { 0x3FEB400, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 7
+        { 0, 0 }, { 0x1F4, 9 }, { 0x3FDC, 14 }, { 0x7FD70, 19 },
+        { 0xFFAF0, 20 }, { 0x1FF600, 21 }, { 0x3FEC40, 22 }, { 0x7FD900, 23 },
+        { 0xFFB300, 24 }, { 0x1FF6800, 25 }, { 0x3FED400, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 8
+        { 0, 0 }, { 0x3F0, 10 }, { 0x1FF00, 17 }, { 0x7FDB0, 19 },
+        { 0xFFB70, 20 }, { 0x1FF700, 21 }, { 0x3FEE40, 22 }, { 0x7FDD00, 23 },
+        { 0xFFBB00, 24 }, { 0x1FF7800, 25 }, { 0x3FEF400, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 9
+        { 0, 0 }, { 0x3F2, 10 }, { 0x3FEF8, 18 }, { 0x7FDF8, 19 },
+        { 0xFFC00, 20 }, { 0x1FF820, 21 }, { 0x3FF080, 22 }, { 0x7FE180, 23 },
+        { 0xFFC400, 24 }, { 0x1FF8A00, 25 }, { 0x3FF1800, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 10
+        { 0, 0 }, { 0x3F4, 10 }, { 0x3FF1C, 18 }, { 0x7FE40, 19 },
+        { 0xFFC90, 20 }, { 0x1FF940, 21 }, { 0x3FF2C0, 22 }, { 0x7FE600, 23 },
+        { 0xFFCD00, 24 }, { 0x1FF9C00, 25 }, { 0x3FF3C00, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 11
+        { 0, 0 }, { 0x7F2, 11 }, { 0x3FF40, 18 }, { 0x7FE88, 19 },
+        { 0xFFD20, 20 }, { 0x1FFA60, 21 }, { 0x3FF500, 22 }, { 0x7FEA80, 23 },
+        { 0xFFD600, 24 }, { 0x1FFAE00, 25 }, { 0x3FF6000, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 12
+        { 0, 0 }, { 0x7F4, 11 }, { 0x3FF64, 18 }, { 0x7FED0, 19 },
+        { 0xFFDB0, 20 }, { 0x1FFB80, 21 }, { 0x3FF740, 22 }, { 0x7FEF00, 23 },
+        { 0xFFDF00, 24 }, { 0x1FFC000, 25 }, { 0x3FF8400, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 13
+        { 0, 0 }, { 0xFF0, 12 }, { 0x3FF88, 18 }, { 0x7FF18, 19 },
+        { 0xFFE40, 20 }, { 0x1FFCA0, 21 }, { 0x3FF980, 22 }, { 0x7FF380, 23 },
+        { 0xFFE800, 24 }, { 0x1FFD200, 25 }, { 0x3FFA800, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 14
+        { 0, 0 }, { 0x1FFD6, 17 }, { 0x3FFB0, 18 }, { 0x7FF68, 19 },
+        { 0xFFEE0, 20 }, { 0x1FFDE0, 21 }, { 0x3FFC00, 22 }, { 0x7FF880, 23 },
+        { 0xFFF200, 24 }, { 0x1FFE600, 25 }, { 0x3FFD000, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+        // Run 15
+        { 0x7F9, 11 }, { 0x1FFEA, 17 }, { 0x3FFD8, 18 }, { 0x7FFB8, 19 },
+        { 0xFFF80, 20 }, { 0x1FFF20, 21 }, { 0x3FFE80, 22 }, { 0x7FFD80, 23 },
+        { 0xFFFC00, 24 }, { 0x1FFFA00, 25 }, { 0x3FFF800, 26 }, { 0, 0 },
+        { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 },
+    },
+};
+
+
+// Grows the buffer so that at least extra more bytes fit
+static bool ensureCapacity(JpegEncoderBuffer* buf, size_t extra) {
+    if (buf->size + extra <= buf->capacity) return true;
+
+    size_t newCap = buf->capacity == 0 ? 1024 : buf->capacity * 2;
+    if (newCap < buf->size + extra) newCap = buf->size + extra + 1024;
+
+    uint8_t* data = (uint8_t*)realloc(buf->data, newCap);
+    if (data == NULL) return false;
+
+    buf->data = data;
+    buf->capacity = newCap;
+    return true;
+}
+
+bool appendJpegEncoderBuffer(JpegEncoderBuffer* buffer, const void* data, size_t size) {
+    if (!ensureCapacity(buffer, size)) return false;
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return true;
+}
+
+// True when any byte of word is 0xFF (zero-byte test applied to ~word)
+#define WORD_HAS_FF(word) \
+    (((~(word) - 0x0101010101010101ULL) & (word) & 0x8080808080808080ULL) != 0)
+
+// Writes a full 64-bit word MSB first. Words without a 0xFF byte, by far the
+// common case, go out as one 8-byte store; otherwise every 0xFF is followed by
+// a stuffed 0x00 unless the writer is raw. The caller guarantees 16 bytes of room.
+static inline void emitWord(BitWriter* bw, uint64_t word) {
+    JpegEncoderBuffer* buf = bw->buffer;
+    uint8_t* out = buf->data + buf->size;
+
+    if (!WORD_HAS_FF(word) || !bw->stuffBytes) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t bigEndian = __builtin_bswap64(word);
+#else
+        uint64_t bigEndian = word;
+#endif
+        memcpy(out, &bigEndian, 8);
+        buf->size += 8;
+        return;
+    }
+
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        uint8_t byte = (uint8_t)(word >> shift);
+        *out++ = byte;
+        if (byte == 0xFF) {
+            *out++ = 0x00;
+        }
+    }
+    buf->size = (size_t)(out - buf->data);
+}
+
+// Appends numBits (0..31) bits of data, MSB first; bits of data above numBits
+// must be zero. Bits collect in a 64-bit accumulator and are written 8 bytes
+// at a time when it fills up.
+static inline void putBits(BitWriter* bw, uint32_t data, int numBits) {
+    bw->freeBits -= numBits;
+    if (bw->freeBits >= 0) {
+        bw->accumulator = (bw->accumulator << numBits) | data;
+        return;
+    }
+
+    // The word is full: top up with the leading bits of data and write it.
+    // The remaining -freeBits bits of data start the next word; the bits above
+    // them are shifted out before that word is written.
+    int overflow = -bw->freeBits;
+    emitWord(bw, (bw->accumulator << (numBits - overflow)) | (data >> overflow));
+    bw->accumulator = data;
+    bw->freeBits += 64;
+}
+
+// Appends 64 bits; the pending bits go first, so the output stays word aligned
+static inline void putWord(BitWriter* bw, uint64_t word) {
+    int pendingBits = 64 - bw->freeBits;
+    if (pendingBits == 0) {
+        emitWord(bw, word);
+        return;
+    }
+    if (pendingBits == 64) {
+        emitWord(bw, bw->accumulator);
+        bw->accumulator = word;
+        return;
     }
+
+    emitWord(bw, (bw->accumulator << bw->freeBits) | (word >> pendingBits));
+    bw->accumulator = word & ((1ULL << pendingBits) - 1);
+}
+
+bool flushBitWriter(BitWriter* bw) {
+    if (!ensureCapacity(bw->buffer, 16)) return false;
+
+    int pendingBits = 64 - bw->freeBits;
+    uint8_t* out = bw->buffer->data + bw->buffer->size;
+
+    // The last partial byte is padded with 1-bits (F.1.2.3)
+    for (int shift = pendingBits - 8; shift > -8; shift -= 8) {
+        uint8_t byte = (uint8_t)(shift >= 0 ? bw->accumulator >> shift
+                                            : (bw->accumulator << -shift) | ((1u << -shift) - 1));
+        *out++ = byte;
+        if (byte == 0xFF) {
+            *out++ = 0x00;
+        }
+    }
+
+    bw->buffer->size = (size_t)(out - bw->buffer->data);
+    bw->accumulator = 0;
+    bw->freeBits = 64;
+    return true;
+}
+
+// Room needed for totalBlocks blocks plus the two words emitBlock may write past them
+static bool reserveBlocks(BitWriter* bw, int totalBlocks) {
+    return ensureCapacity(bw->buffer, (size_t)totalBlocks * HUFFMAN_MAX_BLOCK_BYTES + 16);
 }
 
 // --- Table Generation ---
 
 /**
- * Generates Huffman codes from the standard length counts (nrcodes) and values.
- * This is the Canonical Huffman generation algorithm.
+ * Builds code lengths from symbol counts as in JPEG Annex K.2: repeatedly
+ * merge the two least frequent subtrees, then move codes longer than 16 bits
+ * up the tree (Figure K.3). A reserved symbol with count 1 keeps any code from
+ * being all 1-bits.
  */
-static void generateCodes(const unsigned char* nrcodes, const unsigned char* values, HuffmanCode* table) {
-    uint16_t code = 0;
-    int tableIdx = 0; // Index into the 'values' array
+bool buildOptimalHuffmanSpec(const uint32_t* freq, int numSymbols, HuffmanSpec* spec) {
+    uint64_t count[257];
+    int codeSize[257];
+    int others[257];
+    int bits[33];
 
-    for (int length = 1; length <= 16; length++) {
-        int count = nrcodes[length - 1]; // Number of symbols with this length
-        
-        for (int i = 0; i < count; i++) {
-            unsigned char symbol = values[tableIdx++];
-            table[symbol].code = code;
-            table[symbol].len = length;
-            code++;
+    for (int i = 0; i < 257; i++) {
+        count[i] = (i < numSymbols) ? freq[i] : 0;
+        codeSize[i] = 0;
+        others[i] = -1;
+    }
+    count[256] = 1;
+
+    for (;;) {
+        // c1 = least frequent subtree, c2 = the next one (ties go to the higher symbol)
+        int c1 = -1, c2 = -1;
+        uint64_t v1 = UINT64_MAX, v2 = UINT64_MAX;
+
+        for (int i = 0; i < 257; i++) {
+            if (count[i] == 0) continue;
+            if (count[i] <= v1) {
+                v2 = v1; c2 = c1;
+                v1 = count[i]; c1 = i;
+            } else if (count[i] <= v2) {
+                v2 = count[i]; c2 = i;
+            }
+        }
+
+        if (c2 < 0) break;
+
+        // Merge c2 into c1; every symbol of both subtrees gets one bit longer
+        count[c1] += count[c2];
+        count[c2] = 0;
+
+        codeSize[c1]++;
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            codeSize[c1]++;
+        }
+        others[c1] = c2;
+
+        codeSize[c2]++;
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            codeSize[c2]++;
         }
-        code <<= 1;
     }
-}
 
-static void initHuffmanTables() {
-    if (tablesInitialized) return;
+    memset(bits, 0, sizeof(bits));
+    for (int i = 0; i < 257; i++) {
+        if (codeSize[i] == 0) continue;
+        if (codeSize[i] > 32) return false;
+        bits[codeSize[i]]++;
+    }
+
+    // Limit code lengths to 16 bits: a pair of over-long codes becomes one code of
+    // length i - 1 plus a prefix taken from the longest code shorter than i - 1
+    for (int i = 32; i > 16; i--) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) j--;
 
-    // Zero out first
-    memset(dcTable, 0, sizeof(dcTable));
-    memset(acTable, 0, sizeof(acTable));
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    }
+
+    // Drop the reserved symbol, which holds one of the longest codes
+    int longest = 16;
+    while (longest > 0 && bits[longest] == 0) longest--;
+    if (longest == 0) return false; // No symbols were counted
+    bits[longest]--;
+
+    for (int i = 1; i <= 16; i++) {
+        spec->bits[i - 1] = (uint8_t)bits[i];
+    }
 
-    generateCodes(std_dc_luminance_nrcodes, std_dc_luminance_values, dcTable);
-    generateCodes(std_ac_luminance_nrcodes, std_ac_luminance_values, acTable);
+    // Symbols in order of code length, then symbol value. Lengths moved by the
+    // limiting step above are re-dealt the same way, so only the counts matter.
+    int p = 0;
+    for (int length = 1; length <= 32; length++) {
+        for (int symbol = 0; symbol < numSymbols; symbol++) {
+            if (codeSize[symbol] == length) {
+                spec->values[p++] = (uint8_t)symbol;
+            }
+        }
+    }
+    spec->numValues = p;
 
-    tablesInitialized = 1;
+    return true;
 }
 
-// --- Main Encoder ---
+// Canonical code assignment (Annex C) into the pre-shifted layout of HuffmanCode
+static void generateCodes(const HuffmanSpec* spec, HuffmanCode* table, int tableSize) {
+    memset(table, 0, (size_t)tableSize * sizeof(HuffmanCode));
+
+    uint32_t code = 0;
+    int index = 0;
 
-JpegEncoderBuffer* encodeHuffman(const RLEData* rleData, int totalBlocks) {
-    if (!tablesInitialized) {
-        initHuffmanTables();
+    for (int length = 1; length <= 16; length++) {
+        for (int i = 0; i < spec->bits[length - 1]; i++) {
+            uint8_t symbol = spec->values[index++];
+            int size = symbol & 0x0F;
+
+            table[symbol].code = code << size;
+            table[symbol].len = (uint8_t)(length + size);
+            code++;
+        }
+        code <<= 1;
     }
+}
 
+void buildHuffmanTables(const HuffmanSpec* dcSpec, const HuffmanSpec* acSpec, HuffmanTables* tables) {
+    generateCodes(dcSpec, tables->dc, 16);
+    generateCodes(acSpec, tables->ac, 256);
+}
+
+// --- Main Encoder ---
+
+JpegEncoderBuffer* createJpegEncoderBuffer(size_t capacity) {
     JpegEncoderBuffer* buf = (JpegEncoderBuffer*)malloc(sizeof(JpegEncoderBuffer));
+    if (buf == NULL) return NULL;
+
     buf->data = NULL;
     buf->size = 0;
     buf->capacity = 0;
 
-    BitWriter bw;
-    bw.buffer = buf;
-    bw.accumulator = 0;
-    bw.bitCount = 0;
-
-    int symbolIndex = 0;
-
-    // We must track block boundaries to know when to switch between DC and AC tables.
-    for (int b = 0; b < totalBlocks; b++) {
-        
-        if (symbolIndex >= rleData->count) break;
-
-        // Process DC Coefficient
-        // The first symbol of every block is ALWAYS DC
-        RLESymbol dcSym = rleData->data[symbolIndex++];
-        
-        // Look up code in DC Table
-        HuffmanCode huff = dcTable[dcSym.symbol]; // dcSym.symbol is the Size/Category
-        
-        // Write Huffman Code
-        putBits(&bw, huff.code, huff.len);
-        // Write Amplitude Bits
-        putBits(&bw, dcSym.code, dcSym.codeBits);
-
-        // --- 2. Process AC Coefficients ---
-        int coeffsEncoded = 1; // We just did DC (coeff 0)
-
-        while (coeffsEncoded < 64) {
-            if (symbolIndex >= rleData->count) break;
-
-            RLESymbol acSym = rleData->data[symbolIndex++];
-            
-            // Look up code in AC Table
-            // acSym.symbol is (Run << 4) | Size
-            huff = acTable[acSym.symbol];
-
-            // Write Huffman Code
-            putBits(&bw, huff.code, huff.len);
-            
-            // Write Amplitude Bits (only if Size > 0)
-            if (acSym.codeBits > 0) {
-                putBits(&bw, acSym.code, acSym.codeBits);
-            }
+    if (capacity > 0) {
+        buf->data = (uint8_t*)malloc(capacity);
+        if (buf->data == NULL) {
+            free(buf);
+            return NULL;
+        }
+        buf->capacity = capacity;
+    }
 
-            // Update coefficient counter
-            if (acSym.symbol == 0x00) { 
-                // EOB (End Of Block)
-                // This marks the end of the block, meaning we skip the rest of the 63 coeffs
-                break; 
-            } else if (acSym.symbol == 0xF0) {
-                // ZRL (16 zeros)
-                coeffsEncoded += 16;
-            } else {
-                // Regular symbol: Run zeros + 1 value
-                int run = (acSym.symbol >> 4) & 0x0F;
-                coeffsEncoded += run + 1;
-            }
+    return buf;
+}
+
+void initBitWriter(BitWriter* bw, JpegEncoderBuffer* buffer) {
+    bw->buffer = buffer;
+    bw->accumulator = 0;
+    bw->freeBits = 64;
+    bw->stuffBytes = true;
+}
+
+void initRawBitWriter(BitWriter* bw, JpegEncoderBuffer* buffer) {
+    initBitWriter(bw, buffer);
+    bw->stuffBytes = false;
+}
+
+bool appendRawWords(BitWriter* bw, const uint8_t* data, size_t size) {
+    // Every source byte may need a stuffed 0x00; the rest is room for the tail bits
+    if (!ensureCapacity(bw->buffer, size * 2 + 32)) return false;
+
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        putWord(bw, word);
+    }
+
+    return true;
+}
+
+bool appendRawBits(BitWriter* bw, const BitWriter* raw) {
+    int pendingBits = 64 - raw->freeBits;
+
+    // A raw writer only ever emits whole 64-bit words
+    if (!appendRawWords(bw, raw->buffer->data, raw->buffer->size)) return false;
+
+    // Up to 64 pending bits, in pieces putBits can take
+    for (int remaining = pendingBits; remaining > 0; ) {
+        int numBits = remaining > 24 ? 24 : remaining;
+        remaining -= numBits;
+        putBits(bw, (uint32_t)(raw->accumulator >> remaining) & ((1u << numBits) - 1), numBits);
+    }
+
+    return true;
+}
+
+// --- Run-length analysis ---
+
+/**
+ * Calculates the category (Size) of a value: the bit length of |val|,
+ * e.g. -3 needs 2 bits, 5 needs 3 bits and 0 needs none.
+ * (|val| << 1) | 1 is never zero, so a single clz (lzcnt/bsr) covers val == 0 too.
+ */
+static inline int getBitLength(int val) {
+    unsigned int absVal = (unsigned int)(val < 0 ? -val : val);
+    return 31 - __builtin_clz((absVal << 1) | 1);
+}
+
+// Amplitude bits of a value of the given size: val for positive values,
+// val - 1 (the one's complement of |val|) for negative ones, masked to size bits
+static inline uint32_t getAmplitudeCode(int val, int size) {
+    return (uint32_t)(val + (val >> 31)) & ((1U << size) - 1);
+}
+
+/**
+ * Huffman codes one zig-zag block. nonZero has bit k set when block[k] != 0,
+ * so the loop jumps from one nonzero AC coefficient to the next with tzcnt.
+ * The code tables are pre-shifted by the amplitude size, so every coefficient
+ * is one table lookup OR-ed with its amplitude and one putBits.
+ */
+static inline void encodeBlock(BitWriter* bw, const HuffmanTables* tables, const int16_t* block,
+                               uint64_t nonZero, int16_t* lastDC) {
+    // DC: difference to the previous block, coded by its category
+    int diff = block[0] - *lastDC;
+    *lastDC = block[0];
+
+    int dcSize = getBitLength(diff);
+    HuffmanCode dc = tables->dc[dcSize];
+    putBits(bw, dc.code | getAmplitudeCode(diff, dcSize), dc.len);
+
+    // AC: only the nonzero coefficients are visited
+    uint64_t acMask = nonZero & ~1ULL;
+    int lastIndex = 0;
+
+    while (acMask != 0) {
+        int k = __builtin_ctzll(acMask);
+        acMask &= acMask - 1;
+
+        int zeroCount = k - lastIndex - 1;
+        lastIndex = k;
+
+        // Runs of 16 or more zeros need ZRL symbols (Run=15, Size=0)
+        while (zeroCount >= 16) {
+            putBits(bw, tables->ac[0xF0].code, tables->ac[0xF0].len);
+            zeroCount -= 16;
         }
+
+        int val = block[k];
+        int size = getBitLength(val);
+
+        // Symbol byte: (Run << 4) | Size
+        HuffmanCode ac = tables->ac[(zeroCount << 4) | size];
+        putBits(bw, ac.code | getAmplitudeCode(val, size), ac.len);
+    }
+
+    // End of Block (EOB) when the block ends in zeros
+    if (lastIndex < 63) {
+        putBits(bw, tables->ac[0x00].code, tables->ac[0x00].len);
+    }
+}
+
+/**
+ * Counts the symbols encodeBlock would emit for one block, without coding them.
+ */
+static inline void countBlock(HuffmanStats* stats, const int16_t* block, uint64_t nonZero, int16_t* lastDC) {
+    int diff = block[0] - *lastDC;
+    *lastDC = block[0];
+    stats->dc[getBitLength(diff)]++;
+
+    uint64_t acMask = nonZero & ~1ULL;
+    int lastIndex = 0;
+
+    while (acMask != 0) {
+        int k = __builtin_ctzll(acMask);
+        acMask &= acMask - 1;
+
+        int zeroCount = k - lastIndex - 1;
+        lastIndex = k;
+
+        stats->ac[0xF0] += (uint32_t)(zeroCount >> 4);
+        stats->ac[((zeroCount & 15) << 4) | getBitLength(block[k])]++;
+    }
+
+    if (lastIndex < 63) {
+        stats->ac[0x00]++;
+    }
+}
+
+// Builds the nonzero bitmask of a block one coefficient at a time
+static inline uint64_t nonZeroMaskScalar(const int16_t* block) {
+    uint64_t mask = 0;
+    for (int k = 0; k < 64; k++) {
+        mask |= (uint64_t)(block[k] != 0) << k;
+    }
+    return mask;
+}
+
+bool encodeHuffmanBlocks(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC) {
+    if (!reserveBlocks(bw, zigZagData->totalBlocks)) return false;
+
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        encodeBlock(bw, tables, block, nonZeroMaskScalar(block), lastDC);
+    }
+
+    return true;
+}
+
+void gatherHuffmanStats(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC) {
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        countBlock(stats, block, nonZeroMaskScalar(block), lastDC);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Signed saturation keeps a nonzero int16 nonzero in int8, so the block can be
+// narrowed to bytes, compared with zero and gathered with one movemask per 16 coefficients.
+__attribute__((target("sse2")))
+static inline uint64_t nonZeroMaskSSE2(const int16_t* block) {
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t zeros = 0;
+
+    for (int k = 0; k < 64; k += 16) {
+        __m128i packed = _mm_packs_epi16(_mm_loadu_si128((const __m128i*)&block[k]),
+                                         _mm_loadu_si128((const __m128i*)&block[k + 8]));
+        zeros |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(packed, zero)) << k;
+    }
+    return ~zeros;
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t nonZeroMaskAVX2(const int16_t* block) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t zeros = 0;
+
+    for (int k = 0; k < 64; k += 32) {
+        __m256i packed = _mm256_packs_epi16(_mm256_loadu_si256((const __m256i*)&block[k]),
+                                            _mm256_loadu_si256((const __m256i*)&block[k + 16]));
+        // packs interleaves the 128-bit lanes; restore coefficient order
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        zeros |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(packed, zero)) << k;
+    }
+    return ~zeros;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline uint64_t nonZeroMaskAVX512(const int16_t* block) {
+    __m512i lo = _mm512_loadu_si512(&block[0]);
+    __m512i hi = _mm512_loadu_si512(&block[32]);
+    return (uint64_t)_mm512_test_epi16_mask(lo, lo) | ((uint64_t)_mm512_test_epi16_mask(hi, hi) << 32);
+}
+
+__attribute__((target("sse2")))
+void gatherHuffmanStatsSSE2(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC) {
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        countBlock(stats, block, nonZeroMaskSSE2(block), lastDC);
+    }
+}
+
+__attribute__((target("sse2")))
+bool encodeHuffmanBlocksSSE2(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC) {
+    if (!reserveBlocks(bw, zigZagData->totalBlocks)) return false;
+
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        encodeBlock(bw, tables, block, nonZeroMaskSSE2(block), lastDC);
+    }
+
+    return true;
+}
+
+__attribute__((target("avx2,bmi,lzcnt")))
+void gatherHuffmanStatsAVX2(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC) {
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        countBlock(stats, block, nonZeroMaskAVX2(block), lastDC);
+    }
+}
+
+__attribute__((target("avx2,bmi,lzcnt")))
+bool encodeHuffmanBlocksAVX2(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC) {
+    if (!reserveBlocks(bw, zigZagData->totalBlocks)) return false;
+
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        encodeBlock(bw, tables, block, nonZeroMaskAVX2(block), lastDC);
+    }
+
+    return true;
+}
+
+__attribute__((target("avx512f,avx512bw,bmi,lzcnt")))
+void gatherHuffmanStatsAVX512(HuffmanStats* stats, const ZigZagData* zigZagData, int16_t* lastDC) {
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        countBlock(stats, block, nonZeroMaskAVX512(block), lastDC);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw,bmi,lzcnt")))
+bool encodeHuffmanBlocksAVX512(BitWriter* bw, const HuffmanTables* tables, const ZigZagData* zigZagData, int16_t* lastDC) {
+    if (!reserveBlocks(bw, zigZagData->totalBlocks)) return false;
+
+    for (int i = 0; i < zigZagData->totalBlocks; i++) {
+        const int16_t* block = &zigZagData->data[i * 64];
+        encodeBlock(bw, tables, block, nonZeroMaskAVX512(block), lastDC);
+    }
+
+    return true;
+}
+
+#endif
+
+JpegEncoderBuffer* encodeHuffman(const ZigZagData* zigZagData) {
+    JpegEncoderBuffer* buf = createJpegEncoderBuffer(0);
+    if (buf == NULL) return NULL;
+
+    BitWriter bw;
+    initBitWriter(&bw, buf);
+
+    int16_t lastDC = 0;
+    if (!encodeHuffmanBlocks(&bw, &STD_HUFFMAN_TABLES, zigZagData, &lastDC) || !flushBitWriter(&bw)) {
+        freeJpegEncoderBuffer(buf);
+        return NULL;
     }
 
-    flushBits(&bw);
     return buf;
 }
 
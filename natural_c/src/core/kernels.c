@@ -0,0 +1,178 @@
+#include "kernels.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One implementation of a kernel and the level it needs
+typedef struct {
+    KernelLevel level;
+    const char* name;
+    void (*fn)(void);
+} KernelVariant;
+
+#define VARIANT(level, name, fn) { level, name, (void (*)(void))(fn) }
+
+// Candidates for each slot, fastest first. The scalar entry must come last.
+static const KernelVariant COLOR_CONVERT_VARIANTS[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    VARIANT(KERNEL_LEVEL_AVX2, "avx2", convertRGBRowToYAVX2),
+    VARIANT(KERNEL_LEVEL_SSE4, "ssse3", convertRGBRowToYSSSE3),
+#endif
+    VARIANT(KERNEL_LEVEL_SCALAR, "scalar", convertRGBRowToY),
+};
+
+static const KernelVariant COLOR_CONVERT_BGR_VARIANTS[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    VARIANT(KERNEL_LEVEL_AVX2, "avx2", convertBGRRowToYAVX2),
+    VARIANT(KERNEL_LEVEL_SSE4, "ssse3", convertBGRRowToYSSSE3),
+#endif
+    VARIANT(KERNEL_LEVEL_SCALAR, "scalar", convertBGRRowToY),
+};
+
+static const KernelVariant DCT_VARIANTS[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    VARIANT(KERNEL_LEVEL_AVX2, "avx2-fma", computeDCTBlockAVX2),
+#endif
+    VARIANT(KERNEL_LEVEL_SCALAR, "scalar", computeDCTBlock),
+};
+
+static const KernelVariant QUANTIZE_VARIANTS[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    VARIANT(KERNEL_LEVEL_AVX512, "avx512-vpermi2w", quantizeZigZagBlockAVX512),
+    VARIANT(KERNEL_LEVEL_AVX2, "avx2-pshufb", quantizeZigZagBlockAVX2),
+    VARIANT(KERNEL_LEVEL_SSE4, "sse4.1-pshufb", quantizeZigZagBlockSSE4),
+#endif
+    VARIANT(KERNEL_LEVEL_SCALAR, "scalar", quantizeZigZagBlock),
+};
+
+static const KernelVariant QUANTIZE_INT_VARIANTS[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    VARIANT(KERNEL_LEVEL_AVX512, "avx512-mulhi-vpermi2w", quantizeZigZagBlockIntAVX512),
+    VARIANT(KERNEL_LEVEL_AVX2, "avx2-mulhi", quantizeZigZagBlockIntAVX2),
+    VARIANT(KERNEL_LEVEL_SSE4, "sse4-mulhi", quantizeZigZagBlockIntSSE4),
+#endif
+    VARIANT(KERNEL_LEVEL_SCALAR, "scalar", quantizeZigZagBlockInt),
+};
+
+static const KernelVariant HUFFMAN_VARIANTS[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    VARIANT(KERNEL_LEVEL_AVX512, "avx512-tzcnt", encodeHuffmanBlocksAVX512),
+    VARIANT(KERNEL_LEVEL_AVX2, "avx2-tzcnt", encodeHuffmanBlocksAVX2),
+    VARIANT(KERNEL_LEVEL_SSE4, "sse2-ctz", encodeHuffmanBlocksSSE2),
+#endif
+    VARIANT(KERNEL_LEVEL_SCALAR, "scalar", encodeHuffmanBlocks),
+};
+
+static const KernelVariant HUFFMAN_STATS_VARIANTS[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    VARIANT(KERNEL_LEVEL_AVX512, "avx512-tzcnt", gatherHuffmanStatsAVX512),
+    VARIANT(KERNEL_LEVEL_AVX2, "avx2-tzcnt", gatherHuffmanStatsAVX2),
+    VARIANT(KERNEL_LEVEL_SSE4, "sse2-ctz", gatherHuffmanStatsSSE2),
+#endif
+    VARIANT(KERNEL_LEVEL_SCALAR, "scalar", gatherHuffmanStats),
+};
+
+static const char* LEVEL_NAMES[] = { "scalar", "sse4", "avx2", "avx512" };
+
+static JpegKernels kernels;
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+const char* kernelLevelName(KernelLevel level)
+{
+    return LEVEL_NAMES[level];
+}
+
+static KernelLevel detectCPULevel(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (!__builtin_cpu_supports("sse4.1") || !__builtin_cpu_supports("ssse3"))
+        return KERNEL_LEVEL_SCALAR;
+    if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma") ||
+        !__builtin_cpu_supports("bmi") || !__builtin_cpu_supports("lzcnt"))
+        return KERNEL_LEVEL_SSE4;
+    if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512bw") ||
+        !__builtin_cpu_supports("avx512vl"))
+        return KERNEL_LEVEL_AVX2;
+    return KERNEL_LEVEL_AVX512;
+#else
+    return KERNEL_LEVEL_SCALAR;
+#endif
+}
+
+// Applies JPEG_KERNELS; a request above what the CPU supports is ignored
+static KernelLevel applyLevelOverride(KernelLevel cpuLevel)
+{
+    const char* forced = getenv("JPEG_KERNELS");
+    if (forced == NULL || forced[0] == '\0')
+        return cpuLevel;
+
+    for (int level = KERNEL_LEVEL_SCALAR; level <= KERNEL_LEVEL_AVX512; level++)
+    {
+        if (strcmp(forced, LEVEL_NAMES[level]) == 0)
+        {
+            if ((KernelLevel)level > cpuLevel)
+            {
+                fprintf(stderr, "Warning: JPEG_KERNELS=%s not supported by this CPU, using %s\n",
+                        forced, LEVEL_NAMES[cpuLevel]);
+                return cpuLevel;
+            }
+            return (KernelLevel)level;
+        }
+    }
+
+    fprintf(stderr, "Warning: Unknown JPEG_KERNELS value '%s', using %s\n", forced, LEVEL_NAMES[cpuLevel]);
+    return cpuLevel;
+}
+
+static const KernelVariant* pickVariant(const KernelVariant* variants, size_t count, KernelLevel level)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (variants[i].level <= level)
+            return &variants[i];
+    }
+    return &variants[count - 1];
+}
+
+#define BIND(slot, nameSlot, variants, type)                                          \
+    do {                                                                              \
+        const KernelVariant* v = pickVariant(variants, sizeof(variants) / sizeof(variants[0]), kernels.level); \
+        kernels.slot = (type)v->fn;                                                   \
+        kernels.nameSlot = v->name;                                                   \
+    } while (0)
+
+static void initJpegKernels(void)
+{
+    kernels.cpuLevel = detectCPULevel();
+    kernels.level = applyLevelOverride(kernels.cpuLevel);
+
+    BIND(colorConvertRow, colorConvertName, COLOR_CONVERT_VARIANTS, ColorConvertRowFn);
+    BIND(colorConvertBGRRow, colorConvertBGRName, COLOR_CONVERT_BGR_VARIANTS, ColorConvertRowFn);
+    BIND(dctBlock, dctName, DCT_VARIANTS, DCTBlockFn);
+    BIND(quantizeZigZag, quantizeName, QUANTIZE_VARIANTS, QuantizeZigZagFn);
+    BIND(quantizeZigZagInt, quantizeIntName, QUANTIZE_INT_VARIANTS, QuantizeZigZagIntFn);
+    BIND(huffman, huffmanName, HUFFMAN_VARIANTS, HuffmanBandFn);
+    BIND(huffmanStats, huffmanStatsName, HUFFMAN_STATS_VARIANTS, HuffmanStatsFn);
+}
+
+const JpegKernels* getJpegKernels(void)
+{
+    pthread_once(&kernelsOnce, initJpegKernels);
+    return &kernels;
+}
+
+void printJpegKernels(FILE* out)
+{
+    const JpegKernels* k = getJpegKernels();
+
+    fprintf(out, "Kernels (cpu: %s, using: %s)\n", kernelLevelName(k->cpuLevel), kernelLevelName(k->level));
+    fprintf(out, "  color conversion : %s\n", k->colorConvertName);
+    fprintf(out, "  color (bgr view) : %s\n", k->colorConvertBGRName);
+    fprintf(out, "  dct              : %s\n", k->dctName);
+    fprintf(out, "  quantize+zigzag  : %s\n", k->quantizeName);
+    fprintf(out, "  quantize (int)   : %s\n", k->quantizeIntName);
+    fprintf(out, "  rle + huffman    : %s\n", k->huffmanName);
+    fprintf(out, "  huffman stats    : %s\n", k->huffmanStatsName);
+}
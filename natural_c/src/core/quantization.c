@@ -1,22 +1,384 @@
 #include "quantization.h"
+#include "zigzag.h"
+#include <pthread.h>
 
-QuantizedImage* quantizeImage(const DCTImage* dctImg) {
-    if (dctImg == NULL || dctImg->coefficients == NULL) return NULL;
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+const float AAN_SCALE_FACTOR[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+/**
+ * Computes a 16-bit reciprocal so that ((x + corr) * recip) >> shift equals
+ * round(x / divisor) for every 0 <= x < 32768 (same scheme as libjpeg-turbo).
+ */
+static void computeReciprocal(uint16_t divisor, uint16_t* recip, uint16_t* corr, uint8_t* shift) {
+    // b = floor(log2(divisor))
+    int b = 0;
+    while ((divisor >> (b + 1)) != 0) {
+        b++;
+    }
+
+    int r = 16 + b;
+    uint32_t fq = ((uint32_t)1 << r) / divisor;
+    uint32_t fr = ((uint32_t)1 << r) % divisor;
+    uint32_t c = divisor / 2;
+
+    if (fr == 0) {
+        // Power of two: the reciprocal is exact
+        fq >>= 1;
+        r--;
+    } else if (fr <= divisor / 2U) {
+        // Reciprocal rounded down, compensate through the rounding term
+        c++;
+    } else {
+        // Reciprocal rounded up
+        fq++;
+    }
+
+    *recip = (uint16_t)fq;
+    *corr = (uint16_t)c;
+    *shift = (uint8_t)r;
+}
+
+void initQuantTables(QuantTables* tables, const unsigned char quantTbl[64]) {
+    for (int u = 0; u < 8; u++) {
+        for (int v = 0; v < 8; v++) {
+            int i = u * 8 + v;
+            double quantStep = (double)quantTbl[i];
+
+            tables->reciprocals[i] = (float)(1.0 / quantStep);
+
+            // The AAN DCT leaves coefficient (u, v) multiplied by
+            // 8 * AAN_SCALE_FACTOR[u] * AAN_SCALE_FACTOR[v]; dividing by the
+            // same factor here removes it at no extra cost per coefficient.
+            tables->aanReciprocals[i] = (float)(1.0 / (quantStep * AAN_SCALE_FACTOR[u] * AAN_SCALE_FACTOR[v] * 8.0));
+
+            // The integer DCT output is scaled by 8
+            computeReciprocal((uint16_t)(quantTbl[i] * 8),
+                              &tables->intRecip[i], &tables->intCorr[i], &tables->intShift[i]);
+            tables->intScale[i] = (uint16_t)(1U << (32 - tables->intShift[i]));
+        }
+    }
+}
+
+static int clampQuality(int quality) {
+    if (quality < 1) return 1;
+    if (quality > 100) return 100;
+    return quality;
+}
+
+void scaleQuantTable(const unsigned char baseTbl[64], int quality, unsigned char out[64]) {
+    quality = clampQuality(quality);
+
+    // IJG scaling: 5000 / q below 50, 200 - 2q from 50 up (percent of the base table)
+    int scale = (quality < 50) ? 5000 / quality : 200 - quality * 2;
+
+    for (int i = 0; i < 64; i++) {
+        long value = ((long)baseTbl[i] * scale + 50) / 100;
+        if (value < 1) value = 1;
+        if (value > 255) value = 255;
+        out[i] = (unsigned char)value;
+    }
+}
+
+void initQuantProfile(QuantProfile* profile, const unsigned char baseTbl[64], int quality) {
+    profile->quality = clampQuality(quality);
+    scaleQuantTable(baseTbl, profile->quality, profile->table);
+
+    for (int i = 0; i < 64; i++) {
+        profile->dqtPayload[i] = profile->table[ZIGZAG_ORDER[i]];
+    }
+
+    initQuantTables(&profile->tables, profile->table);
+}
+
+// Profiles of the standard table, indexed by quality - 1
+static QuantProfile profileCache[100];
+static bool profileReady[100];
+static pthread_mutex_t profileLock = PTHREAD_MUTEX_INITIALIZER;
+
+const QuantProfile* getQuantProfile(int quality) {
+    int index = clampQuality(quality) - 1;
+
+    if (!__atomic_load_n(&profileReady[index], __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&profileLock);
+        if (!profileReady[index]) {
+            initQuantProfile(&profileCache[index], std_luminance_quant_tbl, index + 1);
+            __atomic_store_n(&profileReady[index], true, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&profileLock);
+    }
+
+    return &profileCache[index];
+}
+
+void quantizeZigZagBlock(const float coeffs[64], const float reciprocals[64], int16_t out[64]) {
+    // Quantize in zig-zag order, so the store already produces the scanned block
+    for (int i = 0; i < 64; i++) {
+        int pos = ZIGZAG_ORDER[i];
+        out[i] = (int16_t)roundf(coeffs[pos] * reciprocals[pos]);
+    }
+}
+
+void quantizeZigZagBlockInt(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]) {
+    for (int i = 0; i < 64; i++) {
+        int pos = ZIGZAG_ORDER[i];
+        int32_t value = coeffs[pos];
+
+        // Quantize the magnitude, then restore the sign
+        uint32_t magnitude = (uint32_t)(value < 0 ? -value : value);
+        uint32_t product = ((magnitude + tables->intCorr[pos]) * tables->intRecip[pos]) >> tables->intShift[pos];
+
+        out[i] = (int16_t)(value < 0 ? -(int32_t)product : (int32_t)product);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// pshufb masks that gather each zig-zag chunk (8 coefficients) from the raster
+// rows it draws on. Chunk j uses entries ZIGZAG_CHUNK_START[j] .. ZIGZAG_CHUNK_START[j + 1] - 1;
+// a -1 byte writes a zero so the partial results can be OR-ed together.
+typedef struct {
+    uint8_t row;
+    int8_t mask[16];
+} ZigZagShuffle;
+
+static const ZigZagShuffle ZIGZAG_SHUFFLE[36] = {
+    { 0, {  0,  1,  2,  3, -1, -1, -1, -1, -1, -1,  4,  5,  6,  7, -1, -1 } },
+    { 1, { -1, -1, -1, -1,  0,  1, -1, -1,  2,  3, -1, -1, -1, -1,  4,  5 } },
+    { 2, { -1, -1, -1, -1, -1, -1,  0,  1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 0, { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  8,  9, 10, 11 } },
+    { 1, { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  6,  7, -1, -1, -1, -1 } },
+    { 2, {  2,  3, -1, -1, -1, -1, -1, -1,  4,  5, -1, -1, -1, -1, -1, -1 } },
+    { 3, { -1, -1,  0,  1, -1, -1,  2,  3, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 4, { -1, -1, -1, -1,  0,  1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 1, {  8,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 2, { -1, -1,  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 3, { -1, -1, -1, -1,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 4, { -1, -1, -1, -1, -1, -1,  2,  3, -1, -1, -1, -1, -1, -1,  4,  5 } },
+    { 5, { -1, -1, -1, -1, -1, -1, -1, -1,  0,  1, -1, -1,  2,  3, -1, -1 } },
+    { 6, { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  1, -1, -1, -1, -1 } },
+    { 0, { -1, -1, -1, -1, -1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1 } },
+    { 1, { -1, -1, -1, -1, 10, 11, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1 } },
+    { 2, { -1, -1,  8,  9, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1 } },
+    { 3, {  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  8,  9 } },
+    { 4, {  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  8,  9 } },
+    { 5, { -1, -1,  4,  5, -1, -1, -1, -1, -1, -1, -1, -1,  6,  7, -1, -1 } },
+    { 6, { -1, -1, -1, -1,  2,  3, -1, -1, -1, -1,  4,  5, -1, -1, -1, -1 } },
+    { 7, { -1, -1, -1, -1, -1, -1,  0,  1,  2,  3, -1, -1, -1, -1, -1, -1 } },
+    { 1, { -1, -1, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 2, { -1, -1, 12, 13, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 3, { 10, 11, -1, -1, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1 } },
+    { 4, { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, -1, -1, -1, -1 } },
+    { 5, { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  8,  9, -1, -1 } },
+    { 6, { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  6,  7 } },
+    { 3, { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1 } },
+    { 4, { -1, -1, -1, -1, -1, -1, -1, -1, 12, 13, -1, -1, 14, 15, -1, -1 } },
+    { 5, { -1, -1, -1, -1, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, 12, 13 } },
+    { 6, { -1, -1, -1, -1,  8,  9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 7, {  4,  5,  6,  7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 } },
+    { 5, { -1, -1, -1, -1, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1 } },
+    { 6, { 10, 11, -1, -1, -1, -1, 12, 13, -1, -1, 14, 15, -1, -1, -1, -1 } },
+    { 7, { -1, -1,  8,  9, 10, 11, -1, -1, -1, -1, -1, -1, 12, 13, 14, 15 } },
+};
+
+static const uint8_t ZIGZAG_CHUNK_START[9] = { 0, 3, 8, 14, 18, 22, 28, 33, 36 };
+
+// Stores eight raster rows of int16 coefficients in zig-zag order without a
+// round trip through memory: 36 pshufb, one per (output chunk, source row) pair.
+__attribute__((target("ssse3")))
+static inline void storeZigZagSSSE3(const __m128i rows[8], int16_t out[64]) {
+#pragma GCC unroll 8
+    for (int j = 0; j < 8; j++) {
+        __m128i chunk = _mm_setzero_si128();
+#pragma GCC unroll 6
+        for (int e = ZIGZAG_CHUNK_START[j]; e < ZIGZAG_CHUNK_START[j + 1]; e++) {
+            __m128i mask = _mm_loadu_si128((const __m128i*)ZIGZAG_SHUFFLE[e].mask);
+            chunk = _mm_or_si128(chunk, _mm_shuffle_epi8(rows[ZIGZAG_SHUFFLE[e].row], mask));
+        }
+        _mm_storeu_si128((__m128i*)&out[j * 8], chunk);
+    }
+}
+
+// Stores 64 raster coefficients, held as two 32-lane halves, in zig-zag order.
+// vpermi2w picks from both halves at once, so two permutes do the whole block.
+__attribute__((target("avx512f,avx512bw")))
+static inline void storeZigZagAVX512(__m512i lo, __m512i hi, int16_t out[64]) {
+    __m512i indexLo = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)&ZIGZAG_ORDER[0]));
+    __m512i indexHi = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)&ZIGZAG_ORDER[32]));
+
+    _mm512_storeu_si512(&out[0], _mm512_permutex2var_epi16(lo, indexLo, hi));
+    _mm512_storeu_si512(&out[32], _mm512_permutex2var_epi16(lo, indexHi, hi));
+}
 
+// roundf for vectors: truncate, then step one away from zero when |fraction| >= 0.5.
+// A plain cvtps rounds half to even and would disagree with the scalar kernel on ties.
+__attribute__((target("sse4.1")))
+static inline __m128i roundHalfAwaySSE4(__m128 v) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 truncated = _mm_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m128 fraction = _mm_andnot_ps(signMask, _mm_sub_ps(v, truncated));
+    __m128 step = _mm_or_ps(_mm_set1_ps(1.0f), _mm_and_ps(v, signMask));
+    step = _mm_and_ps(step, _mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)));
+    return _mm_cvttps_epi32(_mm_add_ps(truncated, step));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i roundHalfAwayAVX2(__m256 v) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 truncated = _mm256_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256 fraction = _mm256_andnot_ps(signMask, _mm256_sub_ps(v, truncated));
+    __m256 step = _mm256_or_ps(_mm256_set1_ps(1.0f), _mm256_and_ps(v, signMask));
+    step = _mm256_and_ps(step, _mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ));
+    return _mm256_cvttps_epi32(_mm256_add_ps(truncated, step));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i roundHalfAwayAVX512(__m512 v) {
+    const __m512i signMask = _mm512_set1_epi32((int)0x80000000);
+    __m512 truncated = _mm512_roundscale_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m512 fraction = _mm512_abs_ps(_mm512_sub_ps(v, truncated));
+    __m512 step = _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(_mm512_set1_ps(1.0f)),
+                                                      _mm512_and_si512(_mm512_castps_si512(v), signMask)));
+    __mmask16 roundUp = _mm512_cmp_ps_mask(fraction, _mm512_set1_ps(0.5f), _CMP_GE_OQ);
+    return _mm512_cvttps_epi32(_mm512_mask_add_ps(truncated, roundUp, truncated, step));
+}
+
+__attribute__((target("sse4.1,ssse3")))
+void quantizeZigZagBlockSSE4(const float coeffs[64], const float reciprocals[64], int16_t out[64]) {
+    __m128i rows[8];
+
+#pragma GCC unroll 8
+    for (int r = 0; r < 8; r++) {
+        __m128i lo = roundHalfAwaySSE4(_mm_mul_ps(_mm_loadu_ps(&coeffs[r * 8]), _mm_load_ps(&reciprocals[r * 8])));
+        __m128i hi = roundHalfAwaySSE4(_mm_mul_ps(_mm_loadu_ps(&coeffs[r * 8 + 4]), _mm_load_ps(&reciprocals[r * 8 + 4])));
+        rows[r] = _mm_packs_epi32(lo, hi);
+    }
+
+    storeZigZagSSSE3(rows, out);
+}
+
+__attribute__((target("avx2")))
+void quantizeZigZagBlockAVX2(const float coeffs[64], const float reciprocals[64], int16_t out[64]) {
+    __m128i rows[8];
+
+#pragma GCC unroll 4
+    for (int r = 0; r < 8; r += 2) {
+        __m256i lo = roundHalfAwayAVX2(_mm256_mul_ps(_mm256_loadu_ps(&coeffs[r * 8]), _mm256_load_ps(&reciprocals[r * 8])));
+        __m256i hi = roundHalfAwayAVX2(_mm256_mul_ps(_mm256_loadu_ps(&coeffs[r * 8 + 8]), _mm256_load_ps(&reciprocals[r * 8 + 8])));
+
+        // packs works per 128-bit lane; the permute restores coefficient order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        rows[r] = _mm256_castsi256_si128(packed);
+        rows[r + 1] = _mm256_extracti128_si256(packed, 1);
+    }
+
+    storeZigZagSSSE3(rows, out);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void quantizeZigZagBlockAVX512(const float coeffs[64], const float reciprocals[64], int16_t out[64]) {
+    __m256i quarters[4];
+
+#pragma GCC unroll 4
+    for (int i = 0; i < 4; i++) {
+        __m512 scaled = _mm512_mul_ps(_mm512_loadu_ps(&coeffs[i * 16]), _mm512_loadu_ps(&reciprocals[i * 16]));
+        quarters[i] = _mm512_cvtsepi32_epi16(roundHalfAwayAVX512(scaled));
+    }
+
+    __m512i lo = _mm512_inserti64x4(_mm512_castsi256_si512(quarters[0]), quarters[1], 1);
+    __m512i hi = _mm512_inserti64x4(_mm512_castsi256_si512(quarters[2]), quarters[3], 1);
+    storeZigZagAVX512(lo, hi, out);
+}
+
+__attribute__((target("sse4.1,ssse3")))
+void quantizeZigZagBlockIntSSE4(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]) {
+    __m128i rows[8];
+
+#pragma GCC unroll 8
+    for (int r = 0; r < 8; r++) {
+        __m128i value = _mm_loadu_si128((const __m128i*)&coeffs[r * 8]);
+        __m128i magnitude = _mm_abs_epi16(value);
+
+        // ((|x| + corr) * recip) >> 16, then >> (shift - 16) via the scale multiply
+        __m128i product = _mm_mulhi_epu16(_mm_add_epi16(magnitude, _mm_load_si128((const __m128i*)&tables->intCorr[r * 8])),
+                                          _mm_load_si128((const __m128i*)&tables->intRecip[r * 8]));
+        product = _mm_mulhi_epu16(product, _mm_load_si128((const __m128i*)&tables->intScale[r * 8]));
+
+        rows[r] = _mm_sign_epi16(product, value);
+    }
+
+    storeZigZagSSSE3(rows, out);
+}
+
+__attribute__((target("avx2")))
+void quantizeZigZagBlockIntAVX2(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]) {
+    __m128i rows[8];
+
+#pragma GCC unroll 4
+    for (int r = 0; r < 8; r += 2) {
+        __m256i value = _mm256_loadu_si256((const __m256i*)&coeffs[r * 8]);
+        __m256i magnitude = _mm256_abs_epi16(value);
+
+        __m256i product = _mm256_mulhi_epu16(_mm256_add_epi16(magnitude, _mm256_load_si256((const __m256i*)&tables->intCorr[r * 8])),
+                                             _mm256_load_si256((const __m256i*)&tables->intRecip[r * 8]));
+        product = _mm256_mulhi_epu16(product, _mm256_load_si256((const __m256i*)&tables->intScale[r * 8]));
+        product = _mm256_sign_epi16(product, value);
+
+        rows[r] = _mm256_castsi256_si128(product);
+        rows[r + 1] = _mm256_extracti128_si256(product, 1);
+    }
+
+    storeZigZagSSSE3(rows, out);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i quantizeIntAVX512(__m512i value, const uint16_t* corr, const uint16_t* recip, const uint16_t* scale) {
+    __m512i magnitude = _mm512_abs_epi16(value);
+    __m512i product = _mm512_mulhi_epu16(_mm512_add_epi16(magnitude, _mm512_loadu_si512(corr)), _mm512_loadu_si512(recip));
+    product = _mm512_mulhi_epu16(product, _mm512_loadu_si512(scale));
+
+    // No psignw at 512 bits: negate the lanes whose input was negative
+    __mmask32 negative = _mm512_movepi16_mask(value);
+    return _mm512_mask_sub_epi16(product, negative, _mm512_setzero_si512(), product);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void quantizeZigZagBlockIntAVX512(const int16_t coeffs[64], const QuantTables* tables, int16_t out[64]) {
+    __m512i lo = quantizeIntAVX512(_mm512_loadu_si512(&coeffs[0]), &tables->intCorr[0], &tables->intRecip[0], &tables->intScale[0]);
+    __m512i hi = quantizeIntAVX512(_mm512_loadu_si512(&coeffs[32]), &tables->intCorr[32], &tables->intRecip[32], &tables->intScale[32]);
+    storeZigZagAVX512(lo, hi, out);
+}
+
+#endif
+
+QuantizedImage* createQuantizedImage(int width, int height) {
     QuantizedImage* qImg = (QuantizedImage*)malloc(sizeof(QuantizedImage));
     if (qImg == NULL) return NULL;
 
-    qImg->width = dctImg->width;
-    qImg->height = dctImg->height;
-    
-    int totalPixels = qImg->width * qImg->height;
-    qImg->data = (int16_t*)malloc(totalPixels * sizeof(int16_t));
+    qImg->width = width;
+    qImg->height = height;
+    qImg->data = (int16_t*)malloc(width * height * sizeof(int16_t));
     
     if (qImg->data == NULL) {
         free(qImg);
         return NULL;
     }
 
+    return qImg;
+}
+
+void quantizeImageInto(const DCTImage* dctImg, QuantizedImage* qImg) {
+    if (dctImg == NULL || dctImg->coefficients == NULL) return;
+    if (qImg == NULL || qImg->data == NULL) return;
+
+    QuantTables tables;
+    initQuantTables(&tables, std_luminance_quant_tbl);
+
     for (int blockY = 0; blockY < dctImg->height; blockY += 8) {
         for (int blockX = 0; blockX < dctImg->width; blockX += 8) {
             
@@ -32,12 +394,20 @@ QuantizedImage* quantizeImage(const DCTImage* dctImg) {
                     
                     // Calculate value
                     float dctValue = dctImg->coefficients[imageIndex];
-                    float quantStep = (float)std_luminance_quant_tbl[quantIndex];
-                    qImg->data[imageIndex] = (int16_t)roundf(dctValue / quantStep);
+                    qImg->data[imageIndex] = (int16_t)roundf(dctValue * tables.reciprocals[quantIndex]);
                 }
             }
         }
     }
+}
+
+QuantizedImage* quantizeImage(const DCTImage* dctImg) {
+    if (dctImg == NULL || dctImg->coefficients == NULL) return NULL;
+
+    QuantizedImage* qImg = createQuantizedImage(dctImg->width, dctImg->height);
+    if (qImg == NULL) return NULL;
+
+    quantizeImageInto(dctImg, qImg);
 
     return qImg;
 }
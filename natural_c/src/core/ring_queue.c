@@ -0,0 +1,134 @@
+#include "ring_queue.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+
+typedef struct {
+    size_t sequence; // Position this cell is ready for (atomic)
+    void* value;
+} RingCell;
+
+// The two positions sit on their own cache lines, so producers and
+// consumers do not invalidate each other's line on every operation
+struct RingQueue {
+    RingCell* cells;
+    size_t mask;
+    size_t enqueuePos __attribute__((aligned(64)));
+    size_t dequeuePos __attribute__((aligned(64)));
+};
+
+RingQueue* createRingQueue(int capacity) {
+    if (capacity < 1) return NULL;
+
+    size_t size = 2;
+    while (size < (size_t)capacity) size <<= 1;
+
+    RingQueue* queue = (RingQueue*)aligned_alloc(64, sizeof(RingQueue));
+    if (queue == NULL) return NULL;
+
+    queue->cells = (RingCell*)malloc(size * sizeof(RingCell));
+    if (queue->cells == NULL) {
+        free(queue);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        queue->cells[i].sequence = i;
+        queue->cells[i].value = NULL;
+    }
+    queue->mask = size - 1;
+    queue->enqueuePos = 0;
+    queue->dequeuePos = 0;
+
+    return queue;
+}
+
+bool tryPushRingQueue(RingQueue* queue, void* value) {
+    size_t pos = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+    RingCell* cell;
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if (diff == 0) {
+            // The cell is free for this lap; claim the position
+            if (__atomic_compare_exchange_n(&queue->enqueuePos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // Full: the consumer has not freed this cell yet
+        } else {
+            pos = __atomic_load_n(&queue->enqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->value = value;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool tryPopRingQueue(RingQueue* queue, void** value) {
+    size_t pos = __atomic_load_n(&queue->dequeuePos, __ATOMIC_RELAXED);
+    RingCell* cell;
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->dequeuePos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // Empty
+        } else {
+            pos = __atomic_load_n(&queue->dequeuePos, __ATOMIC_RELAXED);
+        }
+    }
+
+    *value = cell->value;
+    // Ready for the producer one lap later
+    __atomic_store_n(&cell->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Short waits spin, longer ones give the core away
+static void backOff(int attempt) {
+    if (attempt < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else if (attempt < 256) {
+        sched_yield();
+    } else {
+        struct timespec pause = { 0, 50000 };
+        nanosleep(&pause, NULL);
+    }
+}
+
+void pushRingQueue(RingQueue* queue, void* value) {
+    for (int attempt = 0; !tryPushRingQueue(queue, value); attempt++) {
+        backOff(attempt);
+    }
+}
+
+void* popRingQueue(RingQueue* queue) {
+    void* value;
+    for (int attempt = 0; !tryPopRingQueue(queue, &value); attempt++) {
+        backOff(attempt);
+    }
+    return value;
+}
+
+void freeRingQueue(RingQueue* queue) {
+    if (queue) {
+        free(queue->cells);
+        free(queue);
+    }
+}
@@ -0,0 +1,263 @@
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Tasks of one runThreadPoolTasks call. It lives on the caller's stack,
+// which is safe because the caller returns only when remaining reaches 0.
+typedef struct {
+    ThreadPoolTaskFn fn;
+    void* context;
+    int remaining; // Tasks not finished yet (atomic)
+} TaskGroup;
+
+typedef struct {
+    TaskGroup* group;
+    int index;
+} Task;
+
+// Work-stealing deque: the owner pushes and pops at the bottom (newest
+// first), other workers steal from the top (oldest first).
+typedef struct {
+    pthread_mutex_t mutex;
+    Task* tasks;
+    int capacity;
+    int top;    // Oldest task
+    int bottom; // One past the newest task
+} TaskDeque;
+
+typedef struct {
+    ThreadPool* pool;
+    int index;
+    pthread_t thread;
+} ThreadPoolWorker;
+
+struct ThreadPool {
+    int numThreads;
+    TaskDeque* deques;         // One per worker
+    ThreadPoolWorker* workers; // Helper threads, workers 1..numThreads-1
+    int startedWorkers;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t changed; // Tasks queued, a group finished, or shutdown
+    int queuedTasks;        // Tasks in all deques (atomic)
+    bool shutdown;
+};
+
+// Worker index of the current thread; threads outside the pool act as worker 0
+static __thread ThreadPool* currentPool;
+static __thread int currentWorker;
+
+static int getCurrentWorker(const ThreadPool* pool) {
+    return currentPool == pool ? currentWorker : 0;
+}
+
+static void wakeWorkers(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static bool pushTask(ThreadPool* pool, TaskDeque* deque, Task task) {
+    pthread_mutex_lock(&deque->mutex);
+
+    if (deque->bottom == deque->capacity) {
+        int count = deque->bottom - deque->top;
+
+        if (deque->top > 0) {
+            // Reuse the room left by stolen tasks
+            memmove(deque->tasks, deque->tasks + deque->top, (size_t)count * sizeof(Task));
+        } else {
+            int capacity = deque->capacity == 0 ? 64 : deque->capacity * 2;
+            Task* tasks = (Task*)realloc(deque->tasks, (size_t)capacity * sizeof(Task));
+            if (tasks == NULL) {
+                pthread_mutex_unlock(&deque->mutex);
+                return false;
+            }
+            deque->tasks = tasks;
+            deque->capacity = capacity;
+        }
+
+        deque->top = 0;
+        deque->bottom = count;
+    }
+
+    deque->tasks[deque->bottom++] = task;
+    __atomic_add_fetch(&pool->queuedTasks, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_unlock(&deque->mutex);
+    return true;
+}
+
+static bool popTask(ThreadPool* pool, TaskDeque* deque, bool steal, Task* task) {
+    pthread_mutex_lock(&deque->mutex);
+
+    bool found = deque->bottom > deque->top;
+    if (found) {
+        *task = steal ? deque->tasks[deque->top++] : deque->tasks[--deque->bottom];
+        __atomic_sub_fetch(&pool->queuedTasks, 1, __ATOMIC_SEQ_CST);
+
+        if (deque->top == deque->bottom) {
+            deque->top = 0;
+            deque->bottom = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&deque->mutex);
+    return found;
+}
+
+// Own deque first, then the other workers' in turn
+static bool takeTask(ThreadPool* pool, int worker, Task* task) {
+    if (popTask(pool, &pool->deques[worker], false, task)) return true;
+
+    for (int i = 1; i < pool->numThreads; i++) {
+        int victim = (worker + i) % pool->numThreads;
+        if (popTask(pool, &pool->deques[victim], true, task)) return true;
+    }
+
+    return false;
+}
+
+static void runTask(ThreadPool* pool, Task task, int worker) {
+    TaskGroup* group = task.group;
+    group->fn(group->context, task.index, worker);
+
+    // The group may be gone as soon as remaining hits 0
+    if (__atomic_sub_fetch(&group->remaining, 1, __ATOMIC_SEQ_CST) == 0) {
+        wakeWorkers(pool);
+    }
+}
+
+static void* workerMain(void* arg) {
+    ThreadPoolWorker* worker = (ThreadPoolWorker*)arg;
+    ThreadPool* pool = worker->pool;
+
+    currentPool = pool;
+    currentWorker = worker->index;
+
+    for (;;) {
+        Task task;
+        if (takeTask(pool, worker->index, &task)) {
+            runTask(pool, task, worker->index);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->shutdown && __atomic_load_n(&pool->queuedTasks, __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool->changed, &pool->mutex);
+        }
+        bool shutdown = pool->shutdown;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (shutdown) break;
+    }
+
+    return NULL;
+}
+
+ThreadPool* createThreadPool(int numThreads) {
+    if (numThreads < 1) return NULL;
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (pool == NULL) return NULL;
+
+    pool->numThreads = numThreads;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->changed, NULL);
+
+    pool->deques = (TaskDeque*)calloc((size_t)numThreads, sizeof(TaskDeque));
+    if (pool->deques == NULL) {
+        pool->numThreads = 0;
+        freeThreadPool(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < numThreads; i++) {
+        pthread_mutex_init(&pool->deques[i].mutex, NULL);
+    }
+
+    pool->workers = (ThreadPoolWorker*)calloc((size_t)numThreads, sizeof(ThreadPoolWorker));
+    if (pool->workers == NULL) {
+        freeThreadPool(pool);
+        return NULL;
+    }
+
+    for (int i = 1; i < numThreads; i++) {
+        ThreadPoolWorker* worker = &pool->workers[pool->startedWorkers];
+        worker->pool = pool;
+        worker->index = i;
+
+        if (pthread_create(&worker->thread, NULL, workerMain, worker) != 0) {
+            printf("Error: Failed to start worker thread %d.\n", i);
+            freeThreadPool(pool);
+            return NULL;
+        }
+        pool->startedWorkers++;
+    }
+
+    return pool;
+}
+
+int getThreadPoolSize(const ThreadPool* pool) {
+    return pool->numThreads;
+}
+
+void runThreadPoolTasks(ThreadPool* pool, int numTasks, ThreadPoolTaskFn fn, void* context) {
+    if (numTasks <= 0) return;
+
+    int worker = getCurrentWorker(pool);
+    TaskGroup group = { fn, context, numTasks };
+
+    // Pushed last to first, so this thread pops them in order while thieves
+    // take the far end
+    for (int i = numTasks - 1; i >= 0; i--) {
+        Task task = { &group, i };
+        if (!pushTask(pool, &pool->deques[worker], task)) {
+            runTask(pool, task, worker);
+        }
+    }
+    wakeWorkers(pool);
+
+    // Help instead of blocking: run this group's tasks or anyone else's until
+    // the group is done. This makes nested calls from inside a task safe.
+    while (__atomic_load_n(&group.remaining, __ATOMIC_SEQ_CST) > 0) {
+        Task task;
+        if (takeTask(pool, worker, &task)) {
+            runTask(pool, task, worker);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        while (__atomic_load_n(&group.remaining, __ATOMIC_SEQ_CST) > 0 &&
+               __atomic_load_n(&pool->queuedTasks, __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool->changed, &pool->mutex);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+void freeThreadPool(ThreadPool* pool) {
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->startedWorkers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    for (int i = 0; i < pool->numThreads; i++) {
+        pthread_mutex_destroy(&pool->deques[i].mutex);
+        free(pool->deques[i].tasks);
+    }
+
+    pthread_cond_destroy(&pool->changed);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+}
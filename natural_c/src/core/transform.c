@@ -0,0 +1,55 @@
+#include "transform.h"
+#include "kernels.h"
+
+void transformBlock(const uint8_t* src, int stride, DCTEngine engine, const QuantTables* tables, int16_t out[64])
+{
+    const JpegKernels* kernels = getJpegKernels();
+    int8_t centeredBlock[8][8];
+    float dctBlock[8][8];
+
+    // Level shift (-128) while loading the tile
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            centeredBlock[y][x] = (int8_t)((int)src[y * stride + x] - 128);
+        }
+    }
+
+    if (engine == DCT_ENGINE_INTEGER)
+    {
+        int16_t intBlock[8][8];
+
+        // Integer path: the output is scaled by 8, which the reciprocals account for
+        computeDCTBlockInt(centeredBlock, intBlock);
+        kernels->quantizeZigZagInt((const int16_t *)intBlock, tables, out);
+    }
+    else if (engine == DCT_ENGINE_AAN)
+    {
+        // Output scaling is folded into the AAN reciprocals
+        computeDCTBlockAAN(centeredBlock, dctBlock);
+        kernels->quantizeZigZag((const float *)dctBlock, tables->aanReciprocals, out);
+    }
+    else
+    {
+        kernels->dctBlock(centeredBlock, dctBlock);
+        kernels->quantizeZigZag((const float *)dctBlock, tables->reciprocals, out);
+    }
+}
+
+void transformBand(const YImage* band, DCTEngine engine, const QuantTables* tables, ZigZagData* zzOut)
+{
+    if (band == NULL || band->data == NULL || tables == NULL || zzOut == NULL || zzOut->data == NULL)
+        return;
+
+    int blockIndex = 0;
+    for (int blockY = 0; blockY < band->height; blockY += 8)
+    {
+        for (int blockX = 0; blockX < band->width; blockX += 8)
+        {
+            const uint8_t* tile = &band->data[blockY * band->width + blockX];
+            transformBlock(tile, band->width, engine, tables, &zzOut->data[blockIndex * 64]);
+            blockIndex++;
+        }
+    }
+}
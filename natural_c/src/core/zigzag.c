@@ -4,7 +4,7 @@
 #include <stdint.h>
 
 // Standard JPEG Zig-Zag order
-static const uint8_t ZIGZAG_ORDER[64] = {
+const uint8_t ZIGZAG_ORDER[64] = {
     0, 1, 8, 16, 9, 2, 3, 10,
     17, 24, 32, 25, 18, 11, 4, 5,
     12, 19, 26, 33, 40, 48, 41, 34,
@@ -14,22 +14,15 @@ static const uint8_t ZIGZAG_ORDER[64] = {
     58, 59, 52, 45, 38, 31, 39, 46,
     53, 60, 61, 54, 47, 55, 62, 63};
 
-/**
- * Performs Zig-Zag scanning on quantized image blocks.
- * Converts 2D image blocks into linear arrays of 64 coefficients.
- */
-ZigZagData *performZigZag(const QuantizedImage *qImg)
+ZigZagData *createZigZagData(int numBlocksW, int numBlocksH)
 {
-    if (qImg == NULL || qImg->data == NULL)
-        return NULL;
-
     ZigZagData *zzData = (ZigZagData *)malloc(sizeof(ZigZagData));
     if (zzData == NULL)
         return NULL;
 
-    zzData->numBlocksW = qImg->width / 8;
-    zzData->numBlocksH = qImg->height / 8;
-    zzData->totalBlocks = zzData->numBlocksW * zzData->numBlocksH;
+    zzData->numBlocksW = numBlocksW;
+    zzData->numBlocksH = numBlocksH;
+    zzData->totalBlocks = numBlocksW * numBlocksH;
 
     int totalCoeffs = zzData->totalBlocks * 64;
     zzData->data = (int16_t *)malloc(totalCoeffs * sizeof(int16_t));
@@ -40,6 +33,18 @@ ZigZagData *performZigZag(const QuantizedImage *qImg)
         return NULL;
     }
 
+    return zzData;
+}
+
+/**
+ * Performs Zig-Zag scanning on quantized image blocks into a preallocated
+ * ZigZagData whose block counts match the image.
+ */
+void performZigZagInto(const QuantizedImage *qImg, ZigZagData *zzData)
+{
+    if (qImg == NULL || qImg->data == NULL || zzData == NULL || zzData->data == NULL)
+        return;
+
     int blockIndex = 0;
     // Iterate through image block by block
     for (int blockY = 0; blockY < qImg->height; blockY += 8)
@@ -63,6 +68,22 @@ ZigZagData *performZigZag(const QuantizedImage *qImg)
             blockIndex++;
         }
     }
+}
+
+/**
+ * Performs Zig-Zag scanning on quantized image blocks.
+ * Converts 2D image blocks into linear arrays of 64 coefficients.
+ */
+ZigZagData *performZigZag(const QuantizedImage *qImg)
+{
+    if (qImg == NULL || qImg->data == NULL)
+        return NULL;
+
+    ZigZagData *zzData = createZigZagData(qImg->width / 8, qImg->height / 8);
+    if (zzData == NULL)
+        return NULL;
+
+    performZigZagInto(qImg, zzData);
 
     return zzData;
 }
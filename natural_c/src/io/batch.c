@@ -0,0 +1,346 @@
+#include "batch.h"
+#include "ring_queue.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+static double nowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char *joinPath(const char *dir, const char *name, const char *extension)
+{
+    size_t dirLength = strlen(dir);
+    size_t nameLength = strlen(name);
+    size_t extensionLength = strlen(extension);
+
+    char *path = (char *)malloc(dirLength + 1 + nameLength + extensionLength + 1);
+    if (path == NULL)
+        return NULL;
+
+    memcpy(path, dir, dirLength);
+    path[dirLength] = '/';
+    memcpy(path + dirLength + 1, name, nameLength);
+    memcpy(path + dirLength + 1 + nameLength, extension, extensionLength + 1);
+    return path;
+}
+
+// outputDir/<input file name without extension>.jpeg
+static char *defaultOutputPath(const char *inputPath, const char *outputDir)
+{
+    const char *name = strrchr(inputPath, '/');
+    name = name ? name + 1 : inputPath;
+
+    const char *dot = strrchr(name, '.');
+    size_t nameLength = dot && dot != name ? (size_t)(dot - name) : strlen(name);
+
+    char *stem = strndup(name, nameLength);
+    if (stem == NULL)
+        return NULL;
+
+    char *path = joinPath(outputDir, stem, ".jpeg");
+    free(stem);
+    return path;
+}
+
+// Takes ownership of inputPath and outputPath, also on failure
+static bool addBatchJob(BatchJobList *jobs, char *inputPath, char *outputPath)
+{
+    if (inputPath == NULL || outputPath == NULL)
+    {
+        free(inputPath);
+        free(outputPath);
+        return false;
+    }
+
+    if (jobs->count == jobs->capacity)
+    {
+        int capacity = jobs->capacity == 0 ? 16 : jobs->capacity * 2;
+        char **inputs = (char **)realloc(jobs->inputPaths, (size_t)capacity * sizeof(char *));
+        if (inputs)
+            jobs->inputPaths = inputs;
+        char **outputs = (char **)realloc(jobs->outputPaths, (size_t)capacity * sizeof(char *));
+        if (outputs)
+            jobs->outputPaths = outputs;
+
+        if (inputs == NULL || outputs == NULL)
+        {
+            free(inputPath);
+            free(outputPath);
+            return false;
+        }
+        jobs->capacity = capacity;
+    }
+
+    jobs->inputPaths[jobs->count] = inputPath;
+    jobs->outputPaths[jobs->count] = outputPath;
+    jobs->count++;
+    return true;
+}
+
+static int compareNames(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static bool loadDirectoryJobs(DIR *dir, const char *source, const char *outputDir, BatchJobList *jobs)
+{
+    char **names = NULL;
+    int count = 0, capacity = 0;
+    bool ok = true;
+    struct dirent *entry;
+
+    while (ok && (entry = readdir(dir)) != NULL)
+    {
+        size_t length = strlen(entry->d_name);
+        if (length < 5 || strcasecmp(entry->d_name + length - 4, ".bmp") != 0)
+            continue;
+
+        if (count == capacity)
+        {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            char **grown = (char **)realloc(names, (size_t)capacity * sizeof(char *));
+            ok = grown != NULL;
+            if (!ok)
+                break;
+            names = grown;
+        }
+
+        names[count] = strdup(entry->d_name);
+        ok = names[count] != NULL;
+        if (ok)
+            count++;
+    }
+
+    // Sorted, so the batch runs in the same order everywhere
+    if (ok)
+        qsort(names, (size_t)count, sizeof(char *), compareNames);
+
+    for (int i = 0; ok && i < count; i++)
+    {
+        char *inputPath = joinPath(source, names[i], "");
+        ok = addBatchJob(jobs, inputPath, inputPath ? defaultOutputPath(inputPath, outputDir) : NULL);
+    }
+
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+
+    return ok;
+}
+
+static bool loadListJobs(FILE *file, const char *source, const char *outputDir, BatchJobList *jobs)
+{
+    char line[4096];
+    int lineNumber = 0;
+
+    while (fgets(line, sizeof(line), file))
+    {
+        lineNumber++;
+
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+
+        char *save = NULL;
+        char *input = strtok_r(line, " \t\r\n", &save);
+        char *output = strtok_r(NULL, " \t\r\n", &save);
+        if (input == NULL)
+            continue;
+
+        if (strtok_r(NULL, " \t\r\n", &save) != NULL || (output == NULL && outputDir == NULL))
+        {
+            printf("Error: %s:%d: expected \"input\" with an output directory, or \"input output\".\n",
+                   source, lineNumber);
+            return false;
+        }
+
+        char *inputPath = strdup(input);
+        char *outputPath = output ? strdup(output) : defaultOutputPath(input, outputDir);
+        if (!addBatchJob(jobs, inputPath, outputPath))
+            return false;
+    }
+
+    return true;
+}
+
+bool loadBatchJobs(const char *source, const char *outputDir, BatchJobList *jobs)
+{
+    memset(jobs, 0, sizeof(*jobs));
+
+    bool ok;
+    DIR *dir = opendir(source);
+
+    if (dir)
+    {
+        if (outputDir == NULL)
+        {
+            printf("Error: Batch input %s is a directory, so an output directory is required.\n", source);
+            closedir(dir);
+            return false;
+        }
+
+        ok = loadDirectoryJobs(dir, source, outputDir, jobs);
+        closedir(dir);
+    }
+    else
+    {
+        FILE *file = fopen(source, "r");
+        if (!file)
+        {
+            perror("Error opening batch list");
+            return false;
+        }
+
+        ok = loadListJobs(file, source, outputDir, jobs);
+        fclose(file);
+    }
+
+    if (!ok)
+    {
+        printf("Error: Failed to read batch jobs from %s.\n", source);
+        freeBatchJobs(jobs);
+    }
+
+    return ok;
+}
+
+void freeBatchJobs(BatchJobList *jobs)
+{
+    for (int i = 0; i < jobs->count; i++)
+    {
+        free(jobs->inputPaths[i]);
+        free(jobs->outputPaths[i]);
+    }
+
+    free(jobs->inputPaths);
+    free(jobs->outputPaths);
+    memset(jobs, 0, sizeof(*jobs));
+}
+
+// Encoder and input image of one running image task. Tasks take one from
+// the free list and put it back, so after the first few images (and the
+// largest one) the batch runs without allocating. Inputs are mapped, not
+// copied, so the image only holds a view for the duration of the task.
+typedef struct {
+    JpegEncoder *encoder;
+    BMPImage image;
+} BatchScratch;
+
+typedef struct {
+    const BatchJobList *jobs;
+    const JpegEncoderConfig *config;
+    RingQueue *freeScratch;
+    long long pixels; // Atomic
+    int numFailed;    // Atomic
+} BatchRun;
+
+static void freeBatchScratch(BatchScratch *scratch)
+{
+    if (scratch)
+    {
+        freeJpegEncoder(scratch->encoder);
+        free(scratch->image.data);
+        free(scratch);
+    }
+}
+
+static BatchScratch *takeBatchScratch(BatchRun *run)
+{
+    void *scratch;
+    if (tryPopRingQueue(run->freeScratch, &scratch))
+        return (BatchScratch *)scratch;
+
+    // More images in flight than ever before, e.g. a waiting task took another image
+    BatchScratch *created = (BatchScratch *)calloc(1, sizeof(BatchScratch));
+    if (created)
+    {
+        created->encoder = createJpegEncoder(run->config, 0, 0);
+        if (created->encoder == NULL)
+        {
+            free(created);
+            created = NULL;
+        }
+    }
+    return created;
+}
+
+static void encodeBatchImage(void *context, int index, int worker)
+{
+    (void)worker;
+    BatchRun *run = (BatchRun *)context;
+
+    BatchScratch *scratch = takeBatchScratch(run);
+    bool loaded = scratch != NULL && mapBMPImage(run->jobs->inputPaths[index], &scratch->image);
+    bool ok = loaded && saveJPEGGrayscaleWithEncoder(scratch->encoder, run->jobs->outputPaths[index], &scratch->image);
+
+    if (loaded)
+    {
+        __atomic_add_fetch(&run->pixels, (long long)scratch->image.width * scratch->image.height, __ATOMIC_RELAXED);
+        unmapBMPImage(&scratch->image);
+    }
+
+    if (!ok)
+    {
+        printf("Error: Failed to encode %s\n", run->jobs->inputPaths[index]);
+        __atomic_add_fetch(&run->numFailed, 1, __ATOMIC_RELAXED);
+    }
+
+    if (scratch && !tryPushRingQueue(run->freeScratch, scratch))
+        freeBatchScratch(scratch);
+}
+
+bool runBatch(const BatchJobList *jobs, const JpegEncoderConfig *config, BatchResult *result)
+{
+    JpegEncoderConfig batchConfig = *config;
+    ThreadPool *ownedPool = NULL;
+
+    // Images and their bands share one pool, so a waiting image job runs band tasks
+    if (batchConfig.threadPool == NULL)
+    {
+        ownedPool = createThreadPool(config->numThreads > 1 ? config->numThreads : 1);
+        if (ownedPool == NULL)
+        {
+            printf("Error: Failed to start the batch thread pool.\n");
+            return false;
+        }
+        batchConfig.threadPool = ownedPool;
+    }
+
+    BatchRun run;
+    run.jobs = jobs;
+    run.config = &batchConfig;
+    run.freeScratch = createRingQueue(2 * getThreadPoolSize(batchConfig.threadPool));
+    run.pixels = 0;
+    run.numFailed = 0;
+
+    if (run.freeScratch == NULL)
+    {
+        printf("Error: Failed to allocate batch buffers.\n");
+        freeThreadPool(ownedPool);
+        return false;
+    }
+
+    double start = nowSeconds();
+    runThreadPoolTasks(batchConfig.threadPool, jobs->count, encodeBatchImage, &run);
+    double elapsed = nowSeconds() - start;
+
+    void *scratch;
+    while (tryPopRingQueue(run.freeScratch, &scratch))
+        freeBatchScratch((BatchScratch *)scratch);
+    freeRingQueue(run.freeScratch);
+    freeThreadPool(ownedPool);
+
+    result->numImages = jobs->count;
+    result->numFailed = run.numFailed;
+    result->megapixels = (double)run.pixels * 1e-6;
+    result->seconds = elapsed;
+
+    return run.numFailed == 0;
+}
@@ -1,9 +1,14 @@
 #include "bmp_handler.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 // Helper function to free the image memory
 void freeBMPImage(BMPImage* image) {
     if (image) {
+        unmapBMPImage(image);
         if (image->data) {
             free(image->data);
         }
@@ -11,102 +16,127 @@ void freeBMPImage(BMPImage* image) {
     }
 }
 
+// Checks the parts of the headers both loaders depend on
+static bool checkBMPHeaders(const BMPFileHeader* fileHeader, const BMPInfoHeader* infoHeader) {
+    // Check if the file is a BMP file by checking the magic number
+    if (fileHeader->bfType != 0x4D42) {
+        fprintf(stderr, "Error: File is not a valid BMP file.\n");
+        return false;
+    }
+
+    // Check if the image is 24-bit and uncompressed
+    if (infoHeader->biBitCount != 24) {
+        fprintf(stderr, "Error: Only 24-bit BMP images are supported.\n");
+        return false;
+    }
+    if (infoHeader->biCompression != 0) {
+        fprintf(stderr, "Error: Compressed BMP images are not supported.\n");
+        return false;
+    }
+
+    if (infoHeader->biWidth <= 0 || infoHeader->biHeight == 0 || infoHeader->biHeight == INT32_MIN) {
+        fprintf(stderr, "Error: Invalid BMP dimensions.\n");
+        return false;
+    }
+
+    return true;
+}
+
 // Loads a BMP image from a file. Returns NULL on error.
 BMPImage* loadBMPImage(const char* filename) {
+    // Allocate memory for the BMPImage structure
+    BMPImage* image = (BMPImage*)calloc(1, sizeof(BMPImage));
+    if (!image) {
+        fprintf(stderr, "Error: Memory allocation failed for BMPImage struct.\n");
+        return NULL;
+    }
+
+    if (!loadBMPImageInto(filename, image)) {
+        freeBMPImage(image);
+        return NULL;
+    }
+
+    return image;
+}
+
+bool loadBMPImageInto(const char* filename, BMPImage* image) {
+    unmapBMPImage(image);
+
     FILE* file = fopen(filename, "rb");
     if (!file) {
         fprintf(stderr, "Error: Unable to open file: %s\n", filename);
-        return NULL;
+        return false;
     }
 
     BMPFileHeader fileHeader;
     if (fread(&fileHeader, sizeof(BMPFileHeader), 1, file) != 1) {
         fprintf(stderr, "Error: Failed to read BMP file header.\n");
         fclose(file);
-        return NULL;
-    }
-
-    // Check if the file is a BMP file by checking the magic number
-    if (fileHeader.bfType != 0x4D42) {
-        fprintf(stderr, "Error: File is not a valid BMP file.\n");
-        fclose(file);
-        return NULL;
+        return false;
     }
 
     BMPInfoHeader infoHeader;
     if (fread(&infoHeader, sizeof(BMPInfoHeader), 1, file) != 1) {
         fprintf(stderr, "Error: Failed to read BMP info header.\n");
         fclose(file);
-        return NULL;
-    }
-
-    // Check if the image is 24-bit and uncompressed
-    if (infoHeader.biBitCount != 24) {
-        fprintf(stderr, "Error: Only 24-bit BMP images are supported.\n");
-        fclose(file);
-        return NULL;
-    }
-    if (infoHeader.biCompression != 0) {
-        fprintf(stderr, "Error: Compressed BMP images are not supported.\n");
-        fclose(file);
-        return NULL;
+        return false;
     }
 
-    // Allocate memory for the BMPImage structure
-    BMPImage* image = (BMPImage*)malloc(sizeof(BMPImage));
-    if (!image) {
-        fprintf(stderr, "Error: Memory allocation failed for BMPImage struct.\n");
+    if (!checkBMPHeaders(&fileHeader, &infoHeader)) {
         fclose(file);
-        return NULL;
+        return false;
     }
 
-    image->width = infoHeader.biWidth;
-    image->height = infoHeader.biHeight;
+    int width = infoHeader.biWidth;
+    int height = infoHeader.biHeight;
 
     // If the image height is negative, the image is in top-down format;
     // otherwise, we need to invert the rows to store them in top-down format.
     bool flipVertical = true;
-    if (image->height < 0) {
-        image->height = -image->height;
+    if (height < 0) {
+        height = -height;
         flipVertical = false;
     }
 
     // Every row of pixel data is padded to a multiple of 4 bytes.
-    int rowPadded = (image->width * 3 + 3) & (~3);
+    int rowPadded = (width * 3 + 3) & (~3);
     
-    // Allocate memory for pixel data
-    size_t dataSize = image->width * image->height * 3;
-    image->data = (uint8_t*)malloc(dataSize);
-    if (!image->data) {
-        fprintf(stderr, "Error: Memory allocation failed for pixel data.\n");
-        free(image);
-        fclose(file);
-        return NULL;
+    // Allocate memory for pixel data, unless the previous image left a large enough buffer
+    size_t dataSize = (size_t)width * height * 3;
+    if (image->data == NULL || image->capacity < dataSize) {
+        free(image->data);
+        image->capacity = 0;
+        image->data = (uint8_t*)malloc(dataSize);
+        if (!image->data) {
+            fprintf(stderr, "Error: Memory allocation failed for pixel data.\n");
+            fclose(file);
+            return false;
+        }
+        image->capacity = dataSize;
     }
+    image->width = width;
+    image->height = height;
 
     // Seek to the offset where the pixel data starts
     if (fseek(file, fileHeader.bfOffBits, SEEK_SET) != 0) {
         fprintf(stderr, "Error: Unable to seek to bitmap data.\n");
-        freeBMPImage(image);
         fclose(file);
-        return NULL;
+        return false;
     }
 
     uint8_t* rowDataBuffer = (uint8_t*)malloc(rowPadded);
     if (!rowDataBuffer) {
         fprintf(stderr, "Error: Memory allocation failed for row buffer.\n");
-        freeBMPImage(image);
         fclose(file);
-        return NULL;
+        return false;
     }
 
     for (int i = 0; i < image->height; i++) {
         if (fread(rowDataBuffer, 1, rowPadded, file) != (size_t)rowPadded) {
             fprintf(stderr, "Error: Insufficient data reading row %d\n", i);
             free(rowDataBuffer);
-            freeBMPImage(image);
             fclose(file);
-            return NULL;
+            return false;
         }
 
         int destRow = flipVertical ? (image->height - 1 - i) : i;
@@ -125,7 +155,96 @@ BMPImage* loadBMPImage(const char* filename) {
 
     free(rowDataBuffer);
     fclose(file);
-    return image;
+
+    image->pixels = image->data;
+    image->stride = (ptrdiff_t)image->width * 3;
+    image->channelOrder = BMP_CHANNELS_RGB;
+    image->rowPadding = 0;
+    return true;
+}
+
+bool mapBMPImage(const char* filename, BMPImage* image) {
+    unmapBMPImage(image);
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Unable to open file: %s\n", filename);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BMPFileHeader) + sizeof(BMPInfoHeader)) {
+        fprintf(stderr, "Error: Failed to read BMP headers.\n");
+        close(fd);
+        return false;
+    }
+
+    size_t fileSize = (size_t)st.st_size;
+    uint8_t* base = (uint8_t*)mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: Unable to map file: %s\n", filename);
+        return false;
+    }
+
+    BMPFileHeader fileHeader;
+    BMPInfoHeader infoHeader;
+    memcpy(&fileHeader, base, sizeof(BMPFileHeader));
+    memcpy(&infoHeader, base + sizeof(BMPFileHeader), sizeof(BMPInfoHeader));
+
+    if (!checkBMPHeaders(&fileHeader, &infoHeader)) {
+        munmap(base, fileSize);
+        return false;
+    }
+
+    int width = infoHeader.biWidth;
+    int height = infoHeader.biHeight < 0 ? -infoHeader.biHeight : infoHeader.biHeight;
+
+    // Every row of pixel data is padded to a multiple of 4 bytes.
+    size_t rowPadded = ((size_t)width * 3 + 3) & ~(size_t)3;
+    if (fileHeader.bfOffBits > fileSize || (fileSize - fileHeader.bfOffBits) / rowPadded < (size_t)height) {
+        fprintf(stderr, "Error: Insufficient pixel data in %s\n", filename);
+        munmap(base, fileSize);
+        return false;
+    }
+
+    // The encoder reads the rows once, front to back or back to front
+    madvise(base, fileSize, MADV_WILLNEED);
+
+    const uint8_t* firstRow = base + fileHeader.bfOffBits;
+    image->width = width;
+    image->height = height;
+    if (infoHeader.biHeight > 0) {
+        // Bottom-up: the top row is the last one in the file
+        image->pixels = firstRow + (size_t)(height - 1) * rowPadded;
+        image->stride = -(ptrdiff_t)rowPadded;
+    } else {
+        image->pixels = firstRow;
+        image->stride = (ptrdiff_t)rowPadded;
+    }
+    image->channelOrder = BMP_CHANNELS_BGR;
+    image->rowPadding = (int)(rowPadded - (size_t)width * 3);
+    image->mapping = base;
+    image->mappingSize = fileSize;
+    return true;
+}
+
+void unmapBMPImage(BMPImage* image) {
+    if (image->mapping == NULL) {
+        return;
+    }
+
+    munmap(image->mapping, image->mappingSize);
+    image->mapping = NULL;
+    image->mappingSize = 0;
+
+    // The view pointed into the mapping; data may belong to another image
+    image->width = 0;
+    image->height = 0;
+    image->pixels = NULL;
+    image->stride = 0;
+    image->channelOrder = BMP_CHANNELS_RGB;
+    image->rowPadding = 0;
 }
 
 // Saves a BMP image to a file (24-bit uncompressed BMP format).
@@ -1,10 +1,33 @@
 #include "jpeg_handler.h"
 #include "jpeg_tables.h"
+#include "transform.h"
+#include "kernels.h"
+#include "thread_pool.h"
+#include "arena.h"
+#include "chunk_list.h"
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-// Write APP0 (JFIF Header)
-bool write_app0(FILE *file)
+void initJpegEncoderConfig(JpegEncoderConfig *config)
+{
+    config->dctEngine = DCT_ENGINE_SEPARABLE;
+    config->quality = JPEG_DEFAULT_QUALITY;
+    config->quantProfile = NULL;
+    config->optimizeHuffman = false;
+    config->restartRows = 0;
+    config->numThreads = 1;
+    config->threadPool = NULL;
+    config->verbose = true;
+}
+
+// Each header segment is built into a byte buffer by a build_* function, which
+// returns its length, so the encoder can emit all headers with one write.
+// The write_* functions write a single segment to a file.
+
+// APP0 (JFIF Header), preceded by SOI
+static size_t build_app0(uint8_t *out)
 {
     JPEG_Header_APP0 app0;
     memset(&app0, 0, sizeof(app0));
@@ -18,7 +41,8 @@ bool write_app0(FILE *file)
     app0.x_density = SWAP16(96);
     app0.y_density = SWAP16(96);
 
-    return fwrite(&app0, sizeof(app0), 1, file) == 1;
+    memcpy(out, &app0, sizeof(app0));
+    return sizeof(app0);
 }
 
 // Standard Zigzag mapping table
@@ -33,23 +57,22 @@ const unsigned char zigzag_map[64] = {
     53, 60, 61, 54, 47, 55, 62, 63
 };
 
-bool write_dqt(FILE *file)
+static size_t build_dqt(uint8_t *out, const QuantProfile* profile)
 {
     JPEG_DQT dqt;
     dqt.marker = SWAP16(0xFFDB);
     dqt.length = SWAP16(67);
     dqt.qt_info = 0x00;
 
-    // Apply Zigzag reordering
-    for (int i = 0; i < 64; i++) {
-        dqt.table[i] = std_luminance_quant_tbl[zigzag_map[i]];
-    }
+    // The profile already holds the table in zig-zag order
+    memcpy(dqt.table, profile->dqtPayload, sizeof(dqt.table));
 
-    return fwrite(&dqt, sizeof(dqt), 1, file) == 1;
+    memcpy(out, &dqt, sizeof(dqt));
+    return sizeof(dqt);
 }
 
-// Write SOF0 (Image Dimensions)
-bool write_sof0(FILE *file, int width, int height)
+// SOF0 (Image Dimensions)
+static size_t build_sof0(uint8_t *out, int width, int height)
 {
     JPEG_Header_SOF0 sof0;
     sof0.marker = SWAP16(0xFFC0);
@@ -63,11 +86,12 @@ bool write_sof0(FILE *file, int width, int height)
     sof0.samp_factor = 0x11; // 1x1 Subsampling
     sof0.quant_table_id = 0; // Use DQT 0
 
-    return fwrite(&sof0, sizeof(sof0), 1, file) == 1;
+    memcpy(out, &sof0, sizeof(sof0));
+    return sizeof(sof0);
 }
 
-// Write DHT (DC Component)
-bool write_dht_dc(FILE *file)
+// DHT (DC Component)
+static size_t build_dht_dc(uint8_t *out)
 {
     JPEG_DHT_DC dht;
     dht.marker = SWAP16(0xFFC4);
@@ -76,11 +100,12 @@ bool write_dht_dc(FILE *file)
     memcpy(dht.num_k, std_dc_luminance_nrcodes, 16);
     memcpy(dht.val, std_dc_luminance_values, 12);
 
-    return fwrite(&dht, sizeof(dht), 1, file) == 1;
+    memcpy(out, &dht, sizeof(dht));
+    return sizeof(dht);
 }
 
-// Write DHT (AC Component)
-bool write_dht_ac(FILE *file)
+// DHT (AC Component)
+static size_t build_dht_ac(uint8_t *out)
 {
     JPEG_DHT_AC dht;
     dht.marker = SWAP16(0xFFC4);
@@ -89,11 +114,36 @@ bool write_dht_ac(FILE *file)
     memcpy(dht.num_k, std_ac_luminance_nrcodes, 16);
     memcpy(dht.val, std_ac_luminance_values, 162);
 
-    return fwrite(&dht, sizeof(dht), 1, file) == 1;
+    memcpy(out, &dht, sizeof(dht));
+    return sizeof(dht);
+}
+
+// DHT for any table; tableInfo is 0x00 for DC 0 and 0x10 for AC 0
+static size_t build_dht(uint8_t *out, uint8_t tableInfo, const HuffmanSpec *spec)
+{
+    uint16_t length = (uint16_t)(2 + 1 + 16 + spec->numValues);
+
+    out[0] = 0xFF;
+    out[1] = 0xC4;
+    out[2] = (uint8_t)(length >> 8);
+    out[3] = (uint8_t)(length & 0xFF);
+    out[4] = tableInfo;
+    memcpy(&out[5], spec->bits, 16);
+    memcpy(&out[21], spec->values, (size_t)spec->numValues);
+
+    return 2 + (size_t)length;
+}
+
+// DRI (Restart Interval in MCUs)
+static size_t build_dri(uint8_t *out, uint16_t interval)
+{
+    uint8_t segment[6] = { 0xFF, 0xDD, 0x00, 0x04, (uint8_t)(interval >> 8), (uint8_t)(interval & 0xFF) };
+    memcpy(out, segment, sizeof(segment));
+    return sizeof(segment);
 }
 
-// Write SOS (Start of Scan)
-bool write_sos(FILE *file)
+// SOS (Start of Scan)
+static size_t build_sos(uint8_t *out)
 {
     JPEG_Header_SOS sos;
     sos.marker = SWAP16(0xFFDA);
@@ -106,9 +156,27 @@ bool write_sos(FILE *file)
     sos.end_spectral = 63;
     sos.approx_high = 0;
 
-    return fwrite(&sos, sizeof(sos), 1, file) == 1;
+    memcpy(out, &sos, sizeof(sos));
+    return sizeof(sos);
 }
 
+// Writes one segment built by a build_* function
+#define WRITE_SEGMENT(file, build) \
+    do { \
+        uint8_t segment[JPEG_MAX_HEADER_BYTES]; \
+        size_t size = (build); \
+        return fwrite(segment, 1, size, (file)) == size; \
+    } while (0)
+
+bool write_app0(FILE *file) { WRITE_SEGMENT(file, build_app0(segment)); }
+bool write_dqt(FILE *file, const QuantProfile* profile) { WRITE_SEGMENT(file, build_dqt(segment, profile)); }
+bool write_sof0(FILE *file, int width, int height) { WRITE_SEGMENT(file, build_sof0(segment, width, height)); }
+bool write_dht_dc(FILE *file) { WRITE_SEGMENT(file, build_dht_dc(segment)); }
+bool write_dht_ac(FILE *file) { WRITE_SEGMENT(file, build_dht_ac(segment)); }
+bool write_dht(FILE *file, uint8_t tableInfo, const HuffmanSpec *spec) { WRITE_SEGMENT(file, build_dht(segment, tableInfo, spec)); }
+bool write_dri(FILE *file, uint16_t interval) { WRITE_SEGMENT(file, build_dri(segment, interval)); }
+bool write_sos(FILE *file) { WRITE_SEGMENT(file, build_sos(segment)); }
+
 // Write EOI (End of Image)
 bool write_eoi(FILE *file)
 {
@@ -116,171 +184,1028 @@ bool write_eoi(FILE *file)
     return fwrite(&eoi, sizeof(eoi), 1, file) == 1;
 }
 
-bool saveJPEGGrayscale(const char *filename, const BMPImage* img)
+size_t jpegMaxEncodedSize(int width, int height)
 {
-    FILE *file = fopen(filename, "wb");
-    if (!file)
+    if (width <= 0 || height <= 0)
+        return JPEG_MAX_HEADER_BYTES + 2;
+
+    size_t blocksPerBand = ((size_t)width + 7) / 8;
+    size_t numBands = ((size_t)height + 7) / 8;
+
+    // Every restart interval (at most one per band) ends with a padded, possibly
+    // stuffed byte and an RSTn marker; the scan is followed by EOI
+    return JPEG_MAX_HEADER_BYTES + blocksPerBand * numBands * HUFFMAN_MAX_BLOCK_BYTES + numBands * 4 + 2;
+}
+
+// Where an encode goes: an open stream, a caller's memory block that is never
+// grown, or a list of pages that collects the file for writev
+typedef struct {
+    FILE *file;
+    JpegChunkList *chunks;
+    uint8_t *data;
+    size_t capacity;
+    size_t size;   // Bytes written so far
+    bool overflow; // A write did not fit in data
+
+    // Header block left in the encoder for the caller to write (chunk mode)
+    bool deferHeaders;
+    const uint8_t *headers;
+    size_t headerSize;
+} JpegOutput;
+
+static bool writeOutput(JpegOutput *out, const void *bytes, size_t size)
+{
+    if (out->file)
     {
-        perror("Error opening output file");
-        return false;
+        size_t written = fwrite(bytes, 1, size, out->file);
+        out->size += written;
+        return written == size;
     }
 
-    printf("Starting JPEG compression pipeline...\n");
+    if (out->chunks)
+    {
+        if (!appendJpegChunkList(out->chunks, bytes, size))
+            return false;
+        out->size += size;
+        return true;
+    }
 
-    // Converting BMP to JPEG format
-    
-    // Convert to Grayscale
-    YImage *yImage = convertBMPToJPEGGrayscale(img);
-    if(yImage == NULL) {
-        printf("Error: Failed to convert BMP to Grayscale (YImage).\n");
-        // Note: freeBMPImage(img) is typically called by the caller, 
-        // but if required here: freeBMPImage(const_cast<BMPImage*>(img));
+    if (size > out->capacity - out->size)
+    {
+        out->overflow = true;
         return false;
     }
-    
-    // Centering (-128)
-    CenteredYImage *centeredYImage = centerYImage(yImage);
-    if(centeredYImage == NULL) {
-        printf("Error: Failed to center image data.\n");
-        freeYImage(yImage);
+
+    memcpy(out->data + out->size, bytes, size);
+    out->size += size;
+    return true;
+}
+
+// Working set for one 8-row MCU band. It is carved from the encoder's arena
+// for every image and reused for every band, so its size depends only on the
+// image width.
+typedef struct {
+    YImage yBand;
+    ZigZagData zigZagBand;
+    JpegEncoderBuffer *bitstream; // Kept by the encoder between images
+} BandWorkspace;
+
+// Writes the bytes produced so far and empties the buffer.
+// Bits that do not fill a whole 64-bit word yet stay in the BitWriter.
+static bool drainBitstream(JpegOutput *out, JpegEncoderBuffer *buffer, size_t *totalWritten)
+{
+    size_t before = out->size;
+    bool ok = writeOutput(out, buffer->data, buffer->size);
+    *totalWritten += out->size - before;
+
+    if (!ok)
+    {
+        if (!out->overflow)
+            printf("Error: Failed to write bitstream data. Wrote %zu of %zu bytes.\n", out->size - before, buffer->size);
         return false;
     }
 
-    // DCT
-    DCTImage *dctImage = performDCT(centeredYImage);
-    if(dctImage == NULL) {
-        printf("Error: Failed to perform DCT.\n");
-        freeCenteredYImage(centeredYImage);
-        freeYImage(yImage);
+    buffer->size = 0;
+    return true;
+}
+
+// Writes the pages of list and empties it. Pages move to a chunk output as
+// they are, without copying.
+static bool drainChunks(JpegOutput *out, JpegChunkList *list, size_t *totalWritten)
+{
+    bool ok = true;
+
+    if (out->chunks)
+    {
+        *totalWritten += list->size;
+        out->size += list->size;
+        spliceJpegChunkList(out->chunks, list);
+        return true;
+    }
+
+    for (const JpegPage *page = list->head; page && ok; page = page->next)
+    {
+        size_t before = out->size;
+        ok &= writeOutput(out, page->data, page->size);
+        *totalWritten += out->size - before;
+    }
+
+    if (!ok && !out->overflow)
+        printf("Error: Failed to write bitstream data.\n");
+
+    clearJpegChunkList(list);
+    return ok;
+}
+
+bool loadQuantTableFile(const char *path, unsigned char table[64])
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror("Error opening quantization table file");
         return false;
     }
-    
-    // Quantization
-    QuantizedImage *quantizedImage = quantizeImage(dctImage);
-    if(quantizedImage == NULL) {
-        printf("Error: Failed to quantize image.\n");
-        freeDCTImage(dctImage);
-        freeCenteredYImage(centeredYImage);
-        freeYImage(yImage);
+
+    int count = 0;
+    int value = -1; // Number being read, -1 between numbers
+    bool ok = true;
+    int c;
+
+    do
+    {
+        c = fgetc(file);
+
+        if (c >= '0' && c <= '9')
+        {
+            value = (value < 0 ? 0 : value * 10) + (c - '0');
+            ok = value <= 255;
+            continue;
+        }
+
+        // Any other character ends the current number
+        if (value >= 0)
+        {
+            ok = value != 0 && count < 64;
+            if (ok)
+                table[count++] = (unsigned char)value;
+            value = -1;
+        }
+
+        if (c == '#')
+        {
+            while (c != EOF && c != '\n')
+                c = fgetc(file);
+        }
+        else if (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != ',')
+        {
+            ok = false;
+        }
+    } while (ok && c != EOF);
+
+    fclose(file);
+
+    if (!ok || count != 64)
+    {
+        printf("Error: %s must contain exactly 64 values between 1 and 255.\n", path);
         return false;
     }
 
-    printf("Natural C quant (First Block):\n");
-    for (int y = 0; y < 8; y++) {
-        for (int x = 0; x < 8; x++) {
-            int index = y * quantizedImage->width + x; 
-            printf("%d ", quantizedImage->data[index]);
+    return true;
+}
+
+// Color conversion plus transform of one band; prints the first block of the image when verbose
+static void transformImageBand(const BMPImage *img, int band, const JpegEncoderConfig *config, const QuantTables *tables,
+                               YImage *yBand, ZigZagData *zigZagOut)
+{
+    // Convert to Grayscale
+    convertBMPRowsToY(img, band * 8, yBand);
+
+    // Centering (-128), DCT, Quantization and Zig-Zag Scanning in one pass per block
+    transformBand(yBand, config->dctEngine, tables, zigZagOut);
+
+    if (band == 0 && config->verbose)
+    {
+        // Undo the zig-zag scan so the block prints in raster order
+        int16_t rasterBlock[64];
+        for (int i = 0; i < 64; i++) {
+            rasterBlock[zigzag_map[i]] = zigZagOut->data[i];
+        }
+
+        printf("Natural C quant (First Block):\n");
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 8; x++) {
+                printf("%d ", rasterBlock[y * 8 + x]);
+            }
+            printf("\n");
         }
-        printf("\n");
     }
-    
-    // Zig-Zag Scanning
-    ZigZagData *zzd = performZigZag(quantizedImage);
-    if(zzd == NULL) {
-        printf("Error: Failed to perform Zig-Zag scanning.\n");
-        freeQuantizedImage(quantizedImage);
-        freeDCTImage(dctImage);
-        freeCenteredYImage(centeredYImage);
-        freeYImage(yImage);
-        return false;
+}
+
+// Blocks of numBands bands inside a whole-image ZigZagData
+static ZigZagData bandView(const ZigZagData *image, int firstBand, int numBands)
+{
+    ZigZagData view;
+    view.numBlocksW = image->numBlocksW;
+    view.numBlocksH = numBands;
+    view.totalBlocks = image->numBlocksW * numBands;
+    view.data = image->data + (size_t)firstBand * image->numBlocksW * 64;
+    return view;
+}
+
+// Segments encoded per task group; bounds the buffered output to a few segments per thread
+#define SEGMENTS_PER_THREAD 2
+
+// State shared by the tasks of one encode. Bands are grouped into segments,
+// which are coded independently:
+//  - restart intervals: each segment starts with DC predictor 0 and ends with RSTn;
+//  - stitched (threads without restarts): each segment starts from the DC of the
+//    block before it and is coded raw, then appended at the exact bit position
+//    where the previous one ended, so the scan is the same as a serial one.
+// With one thread and no restarts the whole image is a single segment.
+typedef struct {
+    const BMPImage *img;
+    const JpegEncoderConfig *config;
+    const QuantTables *quantTables;
+    const HuffmanTables *huffmanTables;
+    const JpegKernels *kernels;
+
+    int numBands;
+    int bandsPerSegment;
+    int numSegments;
+    bool useRestarts;
+
+    int numWorkers;
+    BandWorkspace *workspaces;  // One per worker
+    HuffmanStats *workerStats;  // One per worker (optimize mode)
+    ZigZagData *imageBlocks;    // Whole image, transformed by the statistics pass (optimize mode)
+
+    int numSlots;               // Segments per task group
+    int firstSegment;           // Segment coded by slot 0 of the current group
+    JpegEncoderBuffer **slotBuffers; // Output of the band being coded
+    JpegChunkList *slotChunks;  // Finished output of each slot, moved there after every band
+    BitWriter *slotWriters;     // Raw writer state of each slot (stitched mode)
+    bool *slotOk;
+} EncodeJob;
+
+// DC pre-pass: the DC predictor the serial coder carries into a segment, i.e.
+// the quantized DC of the last block of the band before it. Only that block is
+// transformed, with the same kernels as the full pass, so the value is exact.
+static int16_t computeSegmentStartDC(const EncodeJob *job, int segment, BandWorkspace *ws)
+{
+    if (job->useRestarts || segment == 0)
+        return 0;
+
+    int band = segment * job->bandsPerSegment - 1;
+    YImage *yBand = &ws->yBand;
+    int16_t block[64];
+
+    convertBMPRowsToY(job->img, band * 8, yBand);
+    transformBlock(&yBand->data[yBand->width - 8], yBand->width, job->config->dctEngine, job->quantTables, block);
+
+    return block[0];
+}
+
+// Statistics pass task: transforms one segment into imageBlocks and counts its symbols
+static void analyzeSegment(void *context, int segment, int worker)
+{
+    EncodeJob *job = (EncodeJob *)context;
+    BandWorkspace *ws = &job->workspaces[worker];
+
+    int firstBand = segment * job->bandsPerSegment;
+    int endBand = firstBand + job->bandsPerSegment;
+    if (endBand > job->numBands)
+        endBand = job->numBands;
+
+    // Other segments may still be transforming the band before this one
+    int16_t lastDC = computeSegmentStartDC(job, segment, ws);
+
+    for (int band = firstBand; band < endBand; band++)
+    {
+        ZigZagData view = bandView(job->imageBlocks, band, 1);
+        transformImageBand(job->img, band, job->config, job->quantTables, &ws->yBand, &view);
     }
-    
-    // Run-Length Encoding
-    RLEData *rld = performRLE(zzd);
-    if(rld == NULL) {
-        printf("Error: Failed to perform Run-Length Encoding.\n");
-        freeZigZagData(zzd);
-        freeQuantizedImage(quantizedImage);
-        freeDCTImage(dctImage);
-        freeCenteredYImage(centeredYImage);
-        freeYImage(yImage);
-        return false;
+
+    ZigZagData segmentBlocks = bandView(job->imageBlocks, firstBand, endBand - firstBand);
+    job->kernels->huffmanStats(&job->workerStats[worker], &segmentBlocks, &lastDC);
+}
+
+// Coding task: entropy codes one whole segment into the pages of its slot
+static void encodeSegment(void *context, int slot, int worker)
+{
+    EncodeJob *job = (EncodeJob *)context;
+    BandWorkspace *ws = &job->workspaces[worker];
+    JpegEncoderBuffer *out = job->slotBuffers[slot];
+    JpegChunkList *chunks = &job->slotChunks[slot];
+
+    int segment = job->firstSegment + slot;
+    int firstBand = segment * job->bandsPerSegment;
+    int endBand = firstBand + job->bandsPerSegment;
+    if (endBand > job->numBands)
+        endBand = job->numBands;
+
+    BitWriter bw;
+    out->size = 0;
+    clearJpegChunkList(chunks);
+
+    int16_t lastDC;
+    if (job->useRestarts)
+    {
+        initBitWriter(&bw, out);
+        lastDC = 0;
     }
-    
-    // Huffman Coding (generate final byte stream)
-    JpegEncoderBuffer *buffer = encodeHuffman(rld, zzd->totalBlocks);
-    if(buffer == NULL) {
-        printf("Error: Failed to perform Huffman encoding.\n");
-        freeRLEData(rld);
-        freeZigZagData(zzd);
-        freeQuantizedImage(quantizedImage);
-        freeDCTImage(dctImage);
-        freeCenteredYImage(centeredYImage);
-        freeYImage(yImage);
-        return false;
+    else
+    {
+        initRawBitWriter(&bw, out);
+
+        // The statistics pass already holds the previous block
+        if (job->imageBlocks && segment > 0)
+            lastDC = job->imageBlocks->data[((size_t)firstBand * job->imageBlocks->numBlocksW - 1) * 64];
+        else
+            lastDC = computeSegmentStartDC(job, segment, ws);
     }
 
-    printf("Pipeline finished. Writing to file...\n");
+    bool ok = true;
 
-    // Writing headers
-    
+    for (int band = firstBand; band < endBand && ok; band++)
+    {
+        ZigZagData view;
+        const ZigZagData *blocks = &ws->zigZagBand;
+
+        if (job->imageBlocks)
+        {
+            view = bandView(job->imageBlocks, band, 1);
+            blocks = &view;
+        }
+        else
+        {
+            transformImageBand(job->img, band, job->config, job->quantTables, &ws->yBand, &ws->zigZagBand);
+        }
+
+        ok &= job->kernels->huffman(&bw, job->huffmanTables, blocks, &lastDC);
+
+        // The slot buffer only ever holds one band (raw: whole words only)
+        ok &= appendJpegChunkList(chunks, out->data, out->size);
+        out->size = 0;
+    }
+
+    // Every interval ends byte-aligned, right before its RSTn marker; a raw
+    // segment keeps its tail bits for the stitcher
+    if (job->useRestarts)
+    {
+        ok &= flushBitWriter(&bw);
+        ok &= appendJpegChunkList(chunks, out->data, out->size);
+        out->size = 0;
+    }
+    else
+    {
+        job->slotWriters[slot] = bw;
+    }
+
+    job->slotOk[slot] = ok;
+}
+
+// Codes the scan segment by segment, SEGMENTS_PER_THREAD per thread at a time,
+// and writes the segments in order: restart intervals with RST0..RST7 between
+// them, raw segments stitched into one continuous bitstream.
+static bool writeSegments(JpegOutput *out, EncodeJob *job, ThreadPool *pool, size_t *totalWritten)
+{
+    BandWorkspace *ws = &job->workspaces[0];
+    BitWriter scan;
+    initBitWriter(&scan, ws->bitstream);
+
+    bool ok = true;
+
+    for (int first = 0; first < job->numSegments && ok; first += job->numSlots)
+    {
+        int count = job->numSegments - first;
+        if (count > job->numSlots)
+            count = job->numSlots;
+
+        job->firstSegment = first;
+        runThreadPoolTasks(pool, count, encodeSegment, job);
+
+        for (int slot = 0; slot < count && ok; slot++)
+        {
+            int segment = first + slot;
+            ok &= job->slotOk[slot];
+
+            JpegChunkList *chunks = &job->slotChunks[slot];
+
+            if (!job->useRestarts)
+            {
+                // Bits go on exactly where the previous segment ended, one page
+                // at a time, then the tail bits left in the slot's writer
+                for (const JpegPage *page = chunks->head; page && ok; page = page->next)
+                {
+                    ok &= appendRawWords(&scan, page->data, page->size);
+                    ok &= drainBitstream(out, ws->bitstream, totalWritten);
+                }
+                clearJpegChunkList(chunks);
+
+                ok &= appendRawBits(&scan, &job->slotWriters[slot]);
+                ok &= drainBitstream(out, ws->bitstream, totalWritten);
+                continue;
+            }
+
+            ok &= drainChunks(out, chunks, totalWritten);
+
+            if (ok && segment < job->numSegments - 1)
+            {
+                uint8_t marker[2] = { 0xFF, (uint8_t)(0xD0 + (segment & 7)) };
+                ok &= writeOutput(out, marker, 2);
+                *totalWritten += 2;
+            }
+        }
+    }
+
+    if (ok && !job->useRestarts)
+    {
+        ok &= flushBitWriter(&scan);
+        ok &= drainBitstream(out, ws->bitstream, totalWritten);
+    }
+
+    return ok;
+}
+
+// Codes the scan as one DC chain, writing the bytes after every band
+static bool writeSingleInterval(JpegOutput *out, EncodeJob *job, size_t *totalWritten)
+{
+    BandWorkspace *ws = &job->workspaces[0];
+
+    BitWriter bw;
+    initBitWriter(&bw, ws->bitstream);
+
+    // DC predictor is carried from band to band
+    int16_t lastDC = 0;
     bool ok = true;
 
+    for (int band = 0; band < job->numBands && ok; band++)
+    {
+        ZigZagData view;
+        const ZigZagData *blocks = &ws->zigZagBand;
+
+        if (job->imageBlocks)
+        {
+            // Already transformed by the statistics pass
+            view = bandView(job->imageBlocks, band, 1);
+            blocks = &view;
+        }
+        else
+        {
+            transformImageBand(job->img, band, job->config, job->quantTables, &ws->yBand, &ws->zigZagBand);
+        }
+
+        // Run-length + Huffman coding straight from the zig-zag blocks (append this band to the byte stream)
+        ok &= job->kernels->huffman(&bw, job->huffmanTables, blocks, &lastDC);
+
+        ok &= drainBitstream(out, ws->bitstream, totalWritten);
+    }
+
+    if (ok)
+    {
+        ok &= flushBitWriter(&bw);
+        ok &= drainBitstream(out, ws->bitstream, totalWritten);
+    }
+
+    return ok;
+}
+
+// Free output pages an encoder keeps for reuse (64 MB); more are freed when returned
+#define JPEG_ENCODER_CACHED_PAGES 1024
+
+struct JpegEncoder {
+    JpegEncoderConfig config;
+    ThreadPool *pool;
+    ThreadPool *ownedPool;       // Started for this encoder when config has no pool
+    int numThreads;
+    bool segmented;              // Restart intervals or several threads
+    int numSlots;                // Segments per task group
+
+    Arena *arena;                // Per-image scratch, reset for every image
+    JpegEncoderBuffer **bitstreams;  // One per worker
+    JpegEncoderBuffer **slotBuffers; // One per slot
+    JpegPagePool *pagePool;
+    JpegChunkList *slotChunks;       // One per slot
+    JpegChunkList fileChunks;        // Scan and EOI of a file written in one go
+
+    // SOI to SOS, built once for the standard tables (per image when optimized);
+    // only the dimensions and the restart interval are patched for each image
+    uint8_t headers[JPEG_MAX_HEADER_BYTES];
+    size_t headerSize;
+    size_t sofOffset; // Start of SOF0 in headers
+    size_t driOffset; // Start of DRI in headers, 0 without restarts
+};
+
+// Builds the header block with zero dimensions; see patchHeaderBlock
+static void buildHeaderBlock(JpegEncoder *encoder, const QuantProfile *quantProfile,
+                             const HuffmanSpec *dcSpec, const HuffmanSpec *acSpec)
+{
+    uint8_t *headers = encoder->headers;
+    size_t size = 0;
+
     // SOI (Start of Image) is part of your APP0 function (0xFFD8)
-    ok &= write_app0(file);
-    
+    size += build_app0(headers + size);
+
     // DQT (Quantization Table)
-    ok &= write_dqt(file);
-    
+    size += build_dqt(headers + size, quantProfile);
+
     // SOF0 (Start of Frame - dimensions)
-    ok &= write_sof0(file, img->width, img->height);
-    
+    encoder->sofOffset = size;
+    size += build_sof0(headers + size, 0, 0);
+
     // DHT (Huffman Tables) - Must write both DC and AC tables
-    ok &= write_dht_dc(file);
-    ok &= write_dht_ac(file);
-    
+    if (dcSpec && acSpec)
+    {
+        size += build_dht(headers + size, 0x00, dcSpec);
+        size += build_dht(headers + size, 0x10, acSpec);
+    }
+    else
+    {
+        size += build_dht_dc(headers + size);
+        size += build_dht_ac(headers + size);
+    }
+
+    // DRI (Restart Interval) - one interval per restartRows MCU rows
+    encoder->driOffset = 0;
+    if (encoder->config.restartRows > 0)
+    {
+        encoder->driOffset = size;
+        size += build_dri(headers + size, 0);
+    }
+
     // SOS (Start of Scan) - Announces start of data
-    ok &= write_sos(file);
+    size += build_sos(headers + size);
+
+    encoder->headerSize = size;
+}
+
+static void patchHeaderBlock(JpegEncoder *encoder, int width, int height, uint16_t restartInterval)
+{
+    // Height and width follow marker, length and precision (big endian)
+    uint8_t *sof = encoder->headers + encoder->sofOffset;
+    sof[5] = (uint8_t)(height >> 8);
+    sof[6] = (uint8_t)(height & 0xFF);
+    sof[7] = (uint8_t)(width >> 8);
+    sof[8] = (uint8_t)(width & 0xFF);
+
+    if (encoder->driOffset)
+    {
+        uint8_t *dri = encoder->headers + encoder->driOffset;
+        dri[4] = (uint8_t)(restartInterval >> 8);
+        dri[5] = (uint8_t)(restartInterval & 0xFF);
+    }
+}
+
+// Arena bytes the scratch of one image needs; mirrors prepareEncodeJob
+static size_t encodeJobArenaSize(const JpegEncoder *encoder, int paddedWidth, int numBands)
+{
+    size_t blocksPerBand = (size_t)paddedWidth / 8;
+    size_t numThreads = (size_t)encoder->numThreads;
+    size_t numSlots = (size_t)encoder->numSlots;
+
+    size_t size = arenaAllocationSize(numThreads * sizeof(BandWorkspace));
+    size += numThreads * (arenaAllocationSize((size_t)paddedWidth * 8) +
+                          arenaAllocationSize(blocksPerBand * 64 * sizeof(int16_t)));
+
+    if (encoder->segmented)
+        size += arenaAllocationSize(numSlots * sizeof(BitWriter)) + arenaAllocationSize(numSlots * sizeof(bool));
+
+    if (encoder->config.optimizeHuffman)
+    {
+        size += arenaAllocationSize(numThreads * sizeof(HuffmanStats));
+        size += arenaAllocationSize(sizeof(ZigZagData));
+        size += arenaAllocationSize(blocksPerBand * (size_t)numBands * 64 * sizeof(int16_t));
+    }
+
+    return size;
+}
+
+// Carves the scratch of one image out of the (just reset) arena
+static bool prepareEncodeJob(JpegEncoder *encoder, EncodeJob *job, int paddedWidth, int numBands)
+{
+    Arena *arena = encoder->arena;
+    int blocksPerBand = paddedWidth / 8;
+
+    job->workspaces = (BandWorkspace *)arenaAlloc(arena, (size_t)encoder->numThreads * sizeof(BandWorkspace));
+    if (job->workspaces == NULL)
+        return false;
+
+    for (int i = 0; i < encoder->numThreads; i++)
+    {
+        BandWorkspace *ws = &job->workspaces[i];
+
+        ws->yBand.width = paddedWidth;
+        ws->yBand.height = 8;
+        ws->yBand.data = (uint8_t *)arenaAlloc(arena, (size_t)paddedWidth * 8);
+
+        ws->zigZagBand.numBlocksW = blocksPerBand;
+        ws->zigZagBand.numBlocksH = 1;
+        ws->zigZagBand.totalBlocks = blocksPerBand;
+        ws->zigZagBand.data = (int16_t *)arenaAlloc(arena, (size_t)blocksPerBand * 64 * sizeof(int16_t));
+
+        ws->bitstream = encoder->bitstreams[i];
+        ws->bitstream->size = 0;
+
+        if (ws->yBand.data == NULL || ws->zigZagBand.data == NULL)
+            return false;
+    }
+
+    if (encoder->segmented)
+    {
+        job->slotBuffers = encoder->slotBuffers;
+        job->slotChunks = encoder->slotChunks;
+        job->slotWriters = (BitWriter *)arenaAlloc(arena, (size_t)job->numSlots * sizeof(BitWriter));
+        job->slotOk = (bool *)arenaAlloc(arena, (size_t)job->numSlots * sizeof(bool));
+        if (job->slotWriters == NULL || job->slotOk == NULL)
+            return false;
+    }
+
+    // Optimized tables depend on the symbol counts of the whole scan, so every
+    // band is transformed and kept before the DHT segments can be written.
+    if (encoder->config.optimizeHuffman)
+    {
+        job->workerStats = (HuffmanStats *)arenaAlloc(arena, (size_t)encoder->numThreads * sizeof(HuffmanStats));
+        job->imageBlocks = (ZigZagData *)arenaAlloc(arena, sizeof(ZigZagData));
+        if (job->workerStats == NULL || job->imageBlocks == NULL)
+            return false;
+
+        memset(job->workerStats, 0, (size_t)encoder->numThreads * sizeof(HuffmanStats));
+        job->imageBlocks->numBlocksW = blocksPerBand;
+        job->imageBlocks->numBlocksH = numBands;
+        job->imageBlocks->totalBlocks = blocksPerBand * numBands;
+        job->imageBlocks->data = (int16_t *)arenaAlloc(arena, (size_t)blocksPerBand * numBands * 64 * sizeof(int16_t));
+        if (job->imageBlocks->data == NULL)
+            return false;
+    }
+
+    return true;
+}
+
+// Makes the arena big enough for the scratch of a paddedWidth x numBands image
+static bool reserveEncoderArena(JpegEncoder *encoder, int paddedWidth, int numBands)
+{
+    size_t size = encodeJobArenaSize(encoder, paddedWidth, numBands);
+    if (encoder->arena && encoder->arena->capacity >= size)
+        return true;
+
+    freeArena(encoder->arena);
+    encoder->arena = createArena(size);
+    return encoder->arena != NULL;
+}
+
+static JpegEncoderBuffer **createEncoderBuffers(int count, size_t capacity)
+{
+    JpegEncoderBuffer **buffers = (JpegEncoderBuffer **)calloc((size_t)count, sizeof(JpegEncoderBuffer *));
+    for (int i = 0; buffers && i < count; i++)
+    {
+        buffers[i] = createJpegEncoderBuffer(capacity);
+        if (buffers[i] == NULL)
+            return buffers; // Cleaned up by the caller
+    }
+    return buffers;
+}
+
+static bool encoderBuffersCreated(JpegEncoderBuffer **buffers, int count)
+{
+    for (int i = 0; buffers && i < count; i++)
+    {
+        if (buffers[i] == NULL)
+            return false;
+    }
+    return buffers != NULL;
+}
+
+static void freeEncoderBuffers(JpegEncoderBuffer **buffers, int count)
+{
+    if (buffers)
+    {
+        for (int i = 0; i < count; i++)
+            freeJpegEncoderBuffer(buffers[i]);
+        free(buffers);
+    }
+}
+
+JpegEncoder *createJpegEncoder(const JpegEncoderConfig *config, int maxWidth, int maxHeight)
+{
+    JpegEncoder *encoder = (JpegEncoder *)calloc(1, sizeof(JpegEncoder));
+    if (encoder == NULL)
+    {
+        printf("Error: Failed to allocate encoder buffers.\n");
+        return NULL;
+    }
+
+    encoder->config = *config;
+
+    // A caller-owned pool keeps its threads between encoders; otherwise this
+    // encoder starts its own
+    encoder->pool = config->threadPool;
+    if (encoder->pool == NULL)
+    {
+        encoder->ownedPool = createThreadPool(config->numThreads > 1 ? config->numThreads : 1);
+        encoder->pool = encoder->ownedPool;
+    }
+    encoder->numThreads = encoder->pool ? getThreadPoolSize(encoder->pool) : 1;
+    encoder->segmented = config->restartRows > 0 || encoder->numThreads > 1;
+    encoder->numSlots = encoder->segmented ? encoder->numThreads * SEGMENTS_PER_THREAD : 0;
+
+    int paddedWidth = maxWidth > 0 ? (maxWidth + 7) & (~7) : 0;
+    int numBands = maxHeight > 0 ? (maxHeight + 7) / 8 : 0;
+
+    // Start at the worst case of one band; longer segments grow them once
+    size_t bandBytes = (size_t)(paddedWidth / 8) * HUFFMAN_MAX_BLOCK_BYTES + 16;
+    encoder->bitstreams = createEncoderBuffers(encoder->numThreads, bandBytes);
+    encoder->slotBuffers = createEncoderBuffers(encoder->numSlots, bandBytes);
+    encoder->pagePool = createJpegPagePool(JPEG_ENCODER_CACHED_PAGES);
+    encoder->slotChunks = (JpegChunkList *)calloc((size_t)(encoder->numSlots > 0 ? encoder->numSlots : 1), sizeof(JpegChunkList));
+    for (int i = 0; encoder->slotChunks && i < encoder->numSlots; i++)
+        initJpegChunkList(&encoder->slotChunks[i], encoder->pagePool);
+    initJpegChunkList(&encoder->fileChunks, encoder->pagePool);
+
+    bool ok = encoder->pool != NULL;
+    ok &= encoderBuffersCreated(encoder->bitstreams, encoder->numThreads);
+    ok &= encoder->numSlots == 0 || encoderBuffersCreated(encoder->slotBuffers, encoder->numSlots);
+    ok &= encoder->pagePool != NULL && encoder->slotChunks != NULL;
+    ok &= reserveEncoderArena(encoder, paddedWidth, numBands);
 
     if (!ok)
     {
-        printf("Error: Failed to write JPEG headers to file.\n");
-        fclose(file);
-        // Clean up memory before returning
-        freeJpegEncoderBuffer(buffer);
-        freeRLEData(rld);
-        freeZigZagData(zzd);
-        freeQuantizedImage(quantizedImage);
-        freeDCTImage(dctImage);
-        freeCenteredYImage(centeredYImage);
-        freeYImage(yImage);
+        printf("Error: Failed to allocate encoder buffers.\n");
+        freeJpegEncoder(encoder);
+        return NULL;
+    }
+
+    // Cached per quality, so this costs nothing after the first encoder
+    const QuantProfile *quantProfile = config->quantProfile ? config->quantProfile : getQuantProfile(config->quality);
+    buildHeaderBlock(encoder, quantProfile, NULL, NULL);
+
+    return encoder;
+}
+
+void freeJpegEncoder(JpegEncoder *encoder)
+{
+    if (encoder)
+    {
+        freeEncoderBuffers(encoder->bitstreams, encoder->numThreads);
+        freeEncoderBuffers(encoder->slotBuffers, encoder->numSlots);
+
+        // Pages go back to the pool before it is freed
+        if (encoder->slotChunks)
+        {
+            for (int i = 0; i < encoder->numSlots; i++)
+                clearJpegChunkList(&encoder->slotChunks[i]);
+            free(encoder->slotChunks);
+        }
+        clearJpegChunkList(&encoder->fileChunks);
+        freeJpegPagePool(encoder->pagePool);
+        freeArena(encoder->arena);
+        freeThreadPool(encoder->ownedPool);
+        free(encoder);
+    }
+}
+
+static bool encodeToOutput(JpegEncoder *encoder, JpegOutput *out, const BMPImage* img);
+
+bool saveJPEGGrayscale(const char *filename, const BMPImage* img)
+{
+    JpegEncoderConfig config;
+    initJpegEncoderConfig(&config);
+
+    return saveJPEGGrayscaleWithConfig(filename, img, &config);
+}
+
+bool saveJPEGGrayscaleWithConfig(const char *filename, const BMPImage* img, const JpegEncoderConfig* config)
+{
+    if (img == NULL || !hasBMPImagePixels(img) || config == NULL)
+    {
+        printf("Error: No image data to compress.\n");
         return false;
     }
 
-    // Writing the compressed data
-    // buffer->data contains raw bytes generated by Huffman.
-    size_t written = fwrite(buffer->data, 1, buffer->size, file);
-    
-    if (written != buffer->size) {
-        printf("Error: Failed to write bitstream data. Wrote %zu of %zu bytes.\n", written, buffer->size);
-        ok = false;
-    } else {
-        printf("Bitstream written: %zu bytes.\n", written);
+    JpegEncoder *encoder = createJpegEncoder(config, img->width, img->height);
+    if (encoder == NULL)
+        return false;
+
+    bool ok = saveJPEGGrayscaleWithEncoder(encoder, filename, img);
+    freeJpegEncoder(encoder);
+    return ok;
+}
+
+bool saveJPEGGrayscaleWithEncoder(JpegEncoder *encoder, const char *filename, const BMPImage* img)
+{
+    if (img == NULL || !hasBMPImagePixels(img))
+    {
+        printf("Error: No image data to compress.\n");
+        return false;
     }
 
-    // EOI (End of Image - 0xFFD9)
-    write_eoi(file);
+    // The whole file is encoded first and then written with a single writev:
+    // the header block as it is and the scan straight from its pages
+    JpegOutput out;
+    memset(&out, 0, sizeof(out));
+    out.chunks = &encoder->fileChunks;
+    out.deferHeaders = true;
 
-    fclose(file);
+    if (!encodeToOutput(encoder, &out, img))
+    {
+        clearJpegChunkList(&encoder->fileChunks);
+        return false;
+    }
 
-    // Free everything in reverse order
-    
-    freeJpegEncoderBuffer(buffer);
-    freeRLEData(rld);
-    freeZigZagData(zzd);
-    freeQuantizedImage(quantizedImage);
-    freeDCTImage(dctImage);
-    freeCenteredYImage(centeredYImage);
-    
-    freeYImage(yImage);
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+    {
+        perror("Error opening output file");
+        clearJpegChunkList(&encoder->fileChunks);
+        return false;
+    }
+
+    bool ok = writeJpegChunkList(fd, out.headers, out.headerSize, &encoder->fileChunks);
+    clearJpegChunkList(&encoder->fileChunks);
+    if (!ok)
+        perror("Error writing output file");
+    ok &= close(fd) == 0;
 
-    if(ok) {
+    if(ok && encoder->config.verbose) {
         printf("Compression successful. File saved: %s\n", filename);
     }
     
     return ok;
 }
 
+bool writeJPEGGrayscale(FILE *file, const BMPImage* img, const JpegEncoderConfig* config)
+{
+    if (img == NULL || !hasBMPImagePixels(img) || config == NULL)
+    {
+        printf("Error: No image data to compress.\n");
+        return false;
+    }
+
+    JpegEncoder *encoder = createJpegEncoder(config, img->width, img->height);
+    if (encoder == NULL)
+        return false;
+
+    bool ok = encodeJPEGGrayscale(encoder, file, img);
+    freeJpegEncoder(encoder);
+    return ok;
+}
+
+// Encodes img as a whole JPEG stream (SOI to EOI) into out
+static bool encodeToOutput(JpegEncoder *encoder, JpegOutput *out, const BMPImage* img)
+{
+    if (img == NULL || !hasBMPImagePixels(img))
+    {
+        printf("Error: No image data to compress.\n");
+        return false;
+    }
+
+    const JpegEncoderConfig *config = &encoder->config;
+
+    // The image is processed one MCU band (8 rows) at a time, from color
+    // conversion to Huffman output, so only one band per thread is held in memory.
+    int paddedWidth = (img->width + 7) & (~7);
+    int blocksPerBand = paddedWidth / 8;
+    int numBands = (img->height + 7) / 8;
+    bool useRestarts = config->restartRows > 0;
+
+    // DRI stores the interval in MCUs (blocks here) as 16 bits
+    if (useRestarts && (long)config->restartRows * blocksPerBand > 0xFFFF)
+    {
+        printf("Error: Restart interval of %d rows is too long for a %d pixel wide image.\n",
+               config->restartRows, img->width);
+        return false;
+    }
+
+    if (config->verbose)
+        printf("Starting JPEG compression pipeline...\n");
+
+    // Cached per quality, so switching quality between images costs nothing
+    const QuantProfile *quantProfile = config->quantProfile ? config->quantProfile : getQuantProfile(config->quality);
+
+    ThreadPool *pool = encoder->pool;
+    int numThreads = encoder->numThreads;
+
+    EncodeJob job;
+    memset(&job, 0, sizeof(job));
+    job.img = img;
+    job.config = config;
+    job.quantTables = &quantProfile->tables;
+    job.huffmanTables = &STD_HUFFMAN_TABLES;
+    job.kernels = getJpegKernels();
+    job.numBands = numBands;
+    job.useRestarts = useRestarts;
+
+    // Stitched segments are sized so that one task group covers the image
+    if (useRestarts)
+        job.bandsPerSegment = config->restartRows;
+    else if (numThreads > 1)
+        job.bandsPerSegment = (numBands + numThreads * SEGMENTS_PER_THREAD - 1) / (numThreads * SEGMENTS_PER_THREAD);
+    else
+        job.bandsPerSegment = numBands;
+
+    if (job.bandsPerSegment < 1)
+        job.bandsPerSegment = 1; // Empty image
+    job.numSegments = (numBands + job.bandsPerSegment - 1) / job.bandsPerSegment;
+    job.numWorkers = numThreads;
+    bool segmented = encoder->segmented;
+    job.numSlots = encoder->numSlots;
+
+    // Everything below comes from the arena, which only grows for a larger image
+    bool ok = reserveEncoderArena(encoder, paddedWidth, numBands);
+    if (ok)
+    {
+        resetArena(encoder->arena);
+        ok = prepareEncodeJob(encoder, &job, paddedWidth, numBands);
+    }
+
+    if (!ok)
+    {
+        printf("Error: Failed to allocate encoder buffers.\n");
+        return false;
+    }
+
+    HuffmanTables optimizedTables;
+    HuffmanSpec dcSpec, acSpec;
+
+    if (config->optimizeHuffman)
+    {
+        runThreadPoolTasks(pool, job.numSegments, analyzeSegment, &job);
+
+        // Sums are the same whichever worker counted which segment
+        HuffmanStats stats;
+        memset(&stats, 0, sizeof(stats));
+        for (int w = 0; w < numThreads; w++)
+        {
+            for (int i = 0; i < 16; i++)
+                stats.dc[i] += job.workerStats[w].dc[i];
+            for (int i = 0; i < 256; i++)
+                stats.ac[i] += job.workerStats[w].ac[i];
+        }
+
+        if (!buildOptimalHuffmanSpec(stats.dc, 16, &dcSpec) || !buildOptimalHuffmanSpec(stats.ac, 256, &acSpec))
+        {
+            printf("Error: Failed to build optimized Huffman tables.\n");
+            return false;
+        }
+
+        buildHuffmanTables(&dcSpec, &acSpec, &optimizedTables);
+        job.huffmanTables = &optimizedTables;
+    }
+
+    // Header block: rebuilt only for optimized tables, then patched with this
+    // image's dimensions and restart interval
+    if (config->optimizeHuffman)
+        buildHeaderBlock(encoder, quantProfile, &dcSpec, &acSpec);
+    patchHeaderBlock(encoder, img->width, img->height, (uint16_t)(useRestarts ? config->restartRows * blocksPerBand : 0));
+
+    if (out->deferHeaders)
+    {
+        // Left in the encoder for the caller's single write
+        out->headers = encoder->headers;
+        out->headerSize = encoder->headerSize;
+    }
+    else if (!writeOutput(out, encoder->headers, encoder->headerSize))
+    {
+        if (!out->overflow)
+            printf("Error: Failed to write JPEG headers to file.\n");
+        return false;
+    }
+
+    size_t totalWritten = 0;
+
+    if (segmented)
+        ok &= writeSegments(out, &job, pool, &totalWritten);
+    else
+        ok &= writeSingleInterval(out, &job, &totalWritten);
+
+    if (config->verbose)
+        printf("Pipeline finished.\n");
+
+    if (ok && config->verbose) {
+        printf("Bitstream written: %zu bytes.\n", totalWritten);
+    }
+
+    // EOI (End of Image - 0xFFD9)
+    uint8_t eoi[2] = { 0xFF, 0xD9 };
+    ok &= writeOutput(out, eoi, sizeof(eoi));
+
+    return ok;
+}
+
+bool encodeJPEGGrayscale(JpegEncoder *encoder, FILE *file, const BMPImage* img)
+{
+    JpegOutput out;
+    memset(&out, 0, sizeof(out));
+    out.file = file;
+
+    return encodeToOutput(encoder, &out, img);
+}
+
+bool encodeJPEGGrayscaleToChunks(JpegEncoder *encoder, const BMPImage* img, JpegChunkList *output)
+{
+    JpegOutput out;
+    memset(&out, 0, sizeof(out));
+    out.chunks = output;
+
+    return encodeToOutput(encoder, &out, img);
+}
+
+bool encodeJPEGGrayscaleToMemory(JpegEncoder *encoder, const BMPImage* img,
+                                 uint8_t *output, size_t capacity, size_t *encodedSize)
+{
+    JpegOutput out;
+    memset(&out, 0, sizeof(out));
+    out.data = output;
+    out.capacity = capacity;
+
+    bool ok = encodeToOutput(encoder, &out, img);
+    *encodedSize = ok ? out.size : 0;
+
+    if (out.overflow)
+        printf("Error: The JPEG does not fit in the %zu byte output buffer (see jpegMaxEncodedSize).\n", capacity);
+
+    return ok;
+}
+
 void freeYImage(YImage *img)
 {
     if (img)
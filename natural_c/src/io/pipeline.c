@@ -0,0 +1,214 @@
+#include "batch.h"
+#include "ring_queue.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Images in flight: one being read, one encoded, one written, one spare
+#define PIPELINE_SLOTS 4
+
+// Output pages kept for reuse by the slots (64 MB)
+#define PIPELINE_CACHED_PAGES 1024
+
+// One image travelling reader -> encoder -> writer. Slots are created up
+// front and recycled; the input stays mapped until the slot is reused and
+// the encoded file's pages go back to a shared pool once written.
+typedef struct {
+    int index;            // Job index
+    BMPImage image;       // View of the mapped input file
+    bool ok;              // Still fine after the stages so far
+    JpegChunkList output; // Encoded file
+} PipelineSlot;
+
+typedef struct {
+    const BatchJobList *jobs;
+    RingQueue *freeSlots; // writer -> reader
+    RingQueue *loaded;    // reader -> encoder
+    RingQueue *encoded;   // encoder -> writer
+    long long pixels;     // Written by the writer only
+    int numFailed;
+} Pipeline;
+
+static double nowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void *readerThread(void *arg)
+{
+    Pipeline *pipeline = (Pipeline *)arg;
+
+    for (int i = 0; i < pipeline->jobs->count; i++)
+    {
+        PipelineSlot *slot = (PipelineSlot *)popRingQueue(pipeline->freeSlots);
+        slot->index = i;
+        // Drops the slot's previous mapping; the kernel starts reading ahead
+        slot->ok = mapBMPImage(pipeline->jobs->inputPaths[i], &slot->image);
+        pushRingQueue(pipeline->loaded, slot);
+    }
+
+    pushRingQueue(pipeline->loaded, NULL); // End of batch
+    return NULL;
+}
+
+// One writev for the whole file, straight from its pages
+static bool writeWholeFile(const char *path, const JpegChunkList *output)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+    {
+        perror("Error opening output file");
+        return false;
+    }
+
+    bool ok = writeJpegChunkList(fd, NULL, 0, output);
+    ok &= close(fd) == 0;
+    return ok;
+}
+
+static void *writerThread(void *arg)
+{
+    Pipeline *pipeline = (Pipeline *)arg;
+    PipelineSlot *slot;
+
+    while ((slot = (PipelineSlot *)popRingQueue(pipeline->encoded)) != NULL)
+    {
+        const char *outputPath = pipeline->jobs->outputPaths[slot->index];
+        bool ok = slot->ok;
+
+        if (ok)
+        {
+            pipeline->pixels += (long long)slot->image.width * slot->image.height;
+
+            ok = writeWholeFile(outputPath, &slot->output);
+        }
+        clearJpegChunkList(&slot->output);
+
+        if (!ok)
+        {
+            printf("Error: Failed to encode %s\n", pipeline->jobs->inputPaths[slot->index]);
+            pipeline->numFailed++;
+        }
+
+        pushRingQueue(pipeline->freeSlots, slot);
+    }
+
+    return NULL;
+}
+
+// Runs on the calling thread; the bands of each image go to the encoder's pool
+static void encodeStage(Pipeline *pipeline, JpegEncoder *encoder)
+{
+    PipelineSlot *slot;
+
+    while ((slot = (PipelineSlot *)popRingQueue(pipeline->loaded)) != NULL)
+    {
+        if (slot->ok)
+            slot->ok = encodeJPEGGrayscaleToChunks(encoder, &slot->image, &slot->output);
+        pushRingQueue(pipeline->encoded, slot);
+    }
+
+    pushRingQueue(pipeline->encoded, NULL);
+}
+
+static void freePipelineSlots(PipelineSlot *slots)
+{
+    for (int i = 0; i < PIPELINE_SLOTS; i++)
+    {
+        clearJpegChunkList(&slots[i].output);
+        unmapBMPImage(&slots[i].image);
+    }
+}
+
+bool runBatchPipeline(const BatchJobList *jobs, const JpegEncoderConfig *config, BatchResult *result)
+{
+    JpegEncoderConfig pipelineConfig = *config;
+    pipelineConfig.verbose = false;
+
+    ThreadPool *ownedPool = NULL;
+    if (pipelineConfig.threadPool == NULL)
+    {
+        ownedPool = createThreadPool(config->numThreads > 1 ? config->numThreads : 1);
+        if (ownedPool == NULL)
+        {
+            printf("Error: Failed to start the batch thread pool.\n");
+            return false;
+        }
+        pipelineConfig.threadPool = ownedPool;
+    }
+
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.jobs = jobs;
+    // Room for every slot plus the end marker, so no push ever waits for space
+    pipeline.freeSlots = createRingQueue(PIPELINE_SLOTS + 1);
+    pipeline.loaded = createRingQueue(PIPELINE_SLOTS + 1);
+    pipeline.encoded = createRingQueue(PIPELINE_SLOTS + 1);
+
+    PipelineSlot slots[PIPELINE_SLOTS];
+    memset(slots, 0, sizeof(slots));
+
+    JpegPagePool *pagePool = createJpegPagePool(PIPELINE_CACHED_PAGES);
+    JpegEncoder *encoder = createJpegEncoder(&pipelineConfig, 0, 0);
+    bool ok = pipeline.freeSlots && pipeline.loaded && pipeline.encoded && pagePool && encoder;
+
+    for (int i = 0; ok && i < PIPELINE_SLOTS; i++)
+    {
+        initJpegChunkList(&slots[i].output, pagePool);
+        pushRingQueue(pipeline.freeSlots, &slots[i]);
+    }
+
+    pthread_t reader, writer;
+    bool readerStarted = false, writerStarted = false;
+    double start = nowSeconds();
+
+    if (ok)
+    {
+        readerStarted = pthread_create(&reader, NULL, readerThread, &pipeline) == 0;
+        writerStarted = readerStarted && pthread_create(&writer, NULL, writerThread, &pipeline) == 0;
+        ok = writerStarted;
+    }
+
+    if (ok)
+    {
+        encodeStage(&pipeline, encoder);
+    }
+    else
+    {
+        printf("Error: Failed to set up the batch pipeline.\n");
+        // Drain the reader so it can finish
+        if (readerStarted)
+        {
+            PipelineSlot *slot;
+            while ((slot = (PipelineSlot *)popRingQueue(pipeline.loaded)) != NULL)
+                pushRingQueue(pipeline.freeSlots, slot);
+        }
+    }
+
+    if (readerStarted)
+        pthread_join(reader, NULL);
+    if (writerStarted)
+        pthread_join(writer, NULL);
+    double elapsed = nowSeconds() - start;
+
+    freePipelineSlots(slots);
+    freeJpegPagePool(pagePool);
+    freeJpegEncoder(encoder);
+    freeRingQueue(pipeline.freeSlots);
+    freeRingQueue(pipeline.loaded);
+    freeRingQueue(pipeline.encoded);
+    freeThreadPool(ownedPool);
+
+    result->numImages = jobs->count;
+    result->numFailed = ok ? pipeline.numFailed : jobs->count;
+    result->megapixels = (double)pipeline.pixels * 1e-6;
+    result->seconds = elapsed;
+
+    return ok && pipeline.numFailed == 0;
+}
@@ -1,35 +1,171 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "jpeg_handler.h"
+#include "kernels.h"
+#include "batch.h"
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "Usage: %s <input_file_path> <output_file_path> [options]\n", program);
+    fprintf(stderr, "       %s --batch <directory|list|manifest> [output_directory] [options]\n", program);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --dct=separable|aan|int  DCT implementation (default: separable)\n");
+    fprintf(stderr, "  --quality=N              IJG quality 1-100 (default: 50)\n");
+    fprintf(stderr, "  --qtable=FILE            Custom 64-entry quantization table (raster order), scaled by --quality\n");
+    fprintf(stderr, "  --optimize               Optimized Huffman tables (two passes, smaller file)\n");
+    fprintf(stderr, "  --restart=N              Restart interval every N MCU rows (default: off)\n");
+    fprintf(stderr, "  --batch                  Encode many images; input is a directory of .bmp files or a\n");
+    fprintf(stderr, "                           text file with \"input [output]\" per line\n");
+    fprintf(stderr, "  --pipeline               With --batch: overlap reading, encoding and writing of images\n");
+    fprintf(stderr, "  --threads=N              Threads for band transform and entropy coding (default: 1)\n");
+}
 
 int main(int argc, char *argv[]) {
-    // Check if sufficient arguments are provided
     // argv[0] is the program name
-    // argv[1] is the input file path 
-    // argv[2] is the output file path
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <input_file_path> <output_file_path>\n", argv[0]);
+    // The first two non-option arguments are the input and output file paths
+    const char* inputPath = NULL;
+    const char* outputPath = NULL;
+
+    const char* qtablePath = NULL;
+    bool batch = false;
+    bool pipeline = false;
+
+    JpegEncoderConfig config;
+    initJpegEncoderConfig(&config);
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strncmp(arg, "--dct=", 6) == 0) {
+            const char* engine = arg + 6;
+            if (strcmp(engine, "separable") == 0) {
+                config.dctEngine = DCT_ENGINE_SEPARABLE;
+            } else if (strcmp(engine, "aan") == 0) {
+                config.dctEngine = DCT_ENGINE_AAN;
+            } else if (strcmp(engine, "int") == 0) {
+                config.dctEngine = DCT_ENGINE_INTEGER;
+            } else {
+                fprintf(stderr, "Error: Unknown DCT engine '%s'\n", engine);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(arg, "--quality=", 10) == 0) {
+            char* end = NULL;
+            long quality = strtol(arg + 10, &end, 10);
+            if (end == arg + 10 || *end != '\0' || quality < 1 || quality > 100) {
+                fprintf(stderr, "Error: Quality must be between 1 and 100\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+            config.quality = (int)quality;
+        } else if (strncmp(arg, "--qtable=", 9) == 0) {
+            qtablePath = arg + 9;
+        } else if (strncmp(arg, "--restart=", 10) == 0) {
+            char* end = NULL;
+            long rows = strtol(arg + 10, &end, 10);
+            if (end == arg + 10 || *end != '\0' || rows < 0 || rows > 0xFFFF) {
+                fprintf(stderr, "Error: Restart interval must be between 0 and 65535 MCU rows\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+            config.restartRows = (int)rows;
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            char* end = NULL;
+            long threads = strtol(arg + 10, &end, 10);
+            if (end == arg + 10 || *end != '\0' || threads < 1 || threads > 256) {
+                fprintf(stderr, "Error: Threads must be between 1 and 256\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+            config.numThreads = (int)threads;
+        } else if (strcmp(arg, "--batch") == 0) {
+            batch = true;
+        } else if (strcmp(arg, "--pipeline") == 0) {
+            pipeline = true;
+        } else if (strcmp(arg, "--optimize") == 0) {
+            config.optimizeHuffman = true;
+        } else if (strncmp(arg, "--", 2) == 0) {
+            fprintf(stderr, "Error: Unknown option '%s'\n", arg);
+            printUsage(argv[0]);
+            return 1;
+        } else if (inputPath == NULL) {
+            inputPath = arg;
+        } else if (outputPath == NULL) {
+            outputPath = arg;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Check if sufficient arguments are provided
+    if (inputPath == NULL || (outputPath == NULL && !batch)) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    const char* inputPath = argv[1];
-    const char* outputPath = argv[2];
+    // Custom table, scaled by the requested quality (50 keeps it as written)
+    QuantProfile customProfile;
+    if (qtablePath != NULL) {
+        unsigned char baseTable[64];
+        if (!loadQuantTableFile(qtablePath, baseTable)) {
+            return 1;
+        }
+        initQuantProfile(&customProfile, baseTable, config.quality);
+        config.quantProfile = &customProfile;
+    }
+
+    // One fixed-size pool for the whole run, so no threads are started per image
+    ThreadPool* pool = createThreadPool(config.numThreads);
+    if (pool == NULL) {
+        fprintf(stderr, "Error: Failed to start %d threads\n", config.numThreads);
+        return 1;
+    }
+    config.threadPool = pool;
 
     printf("Starting processing...\n");
     printf("Input: %s\n", inputPath);
+    printJpegKernels(stdout);
+
+    if (batch) {
+        // outputPath is the output directory here, and may be omitted for a manifest
+        BatchJobList jobs;
+        if (!loadBatchJobs(inputPath, outputPath, &jobs)) {
+            freeThreadPool(pool);
+            return 1;
+        }
+
+        config.verbose = false;
+
+        BatchResult result;
+        bool ok = pipeline ? runBatchPipeline(&jobs, &config, &result)
+                           : runBatch(&jobs, &config, &result);
+        printf("Batch: %d images (%d failed), %.2f MP in %.3f s, %.2f MP/s on %d threads\n",
+               result.numImages, result.numFailed, result.megapixels, result.seconds,
+               result.seconds > 0 ? result.megapixels / result.seconds : 0.0, config.numThreads);
+
+        freeBatchJobs(&jobs);
+        freeThreadPool(pool);
+        return ok ? 0 : 1;
+    }
 
-    // Load BMP using the provided path
-    BMPImage* img = loadBMPImage(inputPath);
+    // Map the BMP at the provided path; the encoder reads its rows in place
+    BMPImage img;
+    memset(&img, 0, sizeof(img));
     
-    if (img) {
-       bool value = saveJPEGGrayscale(outputPath, img);
+    if (mapBMPImage(inputPath, &img)) {
+       bool value = saveJPEGGrayscaleWithConfig(outputPath, &img, &config);
        if(value) 
        {
         printf("Save is sucesfull");
        }
+       unmapBMPImage(&img);
     } else {
         fprintf(stderr, "Error: Failed to load image from %s\n", inputPath);
+        freeThreadPool(pool);
         return 1;
     }
 
+    freeThreadPool(pool);
     return 0;
 }